@@ -0,0 +1,110 @@
+#include "generator.h"
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+void write_compilation_unit(const program_shape &shape, const std::string &dir, unsigned cu) {
+    auto id = std::to_string(cu);
+    std::ofstream out{dir + "/cu_" + id + ".cpp"};
+
+    out << "// generated by debugger_bench, do not edit\n\n";
+    out << "namespace cu_" << id << " {\n\n";
+
+    // a few types and template instantiations per unit so the DIE tree has some real shape
+    out << "struct state {\n    long a;\n    long b;\n    long c;\n};\n\n";
+    out << "template<int N>\nstruct tag {\n    static long apply(long x) { return x * N + " << id << "; }\n};\n\n";
+
+    // chain of always_inline functions, every generated function gets inline_depth nested
+    // DW_TAG_inlined_subroutine entries even at -O0
+    for (unsigned k = shape.inline_depth; k-- > 0;) {
+        out << "__attribute__((always_inline)) static inline long inl_" << k << "(long x) {\n";
+        if (k + 1 == shape.inline_depth) {
+            out << "    return x ^ " << k << ";\n";
+        } else {
+            out << "    return inl_" << k + 1 << "(x + " << k << ") * 3;\n";
+        }
+        out << "}\n\n";
+    }
+
+    out << "} // namespace cu_" << id << "\n\n";
+
+    for (unsigned f = 0; f < shape.functions_per_cu; ++f) {
+        out << "extern \"C\" long f_" << id << '_' << f << "(long x) {\n";
+        out << "    cu_" << id << "::state s{x, " << f << ", x * 2};\n";
+        if (shape.inline_depth) {
+            out << "    s.c = cu_" << id << "::inl_0(s.a + s.b);\n";
+        }
+        out << "    return s.c ^ cu_" << id << "::tag<" << f << ">::apply(x);\n";
+        out << "}\n\n";
+    }
+
+    // keeps every function reachable from main
+    out << "extern \"C\" long cu_" << id << "_call_all(long x) {\n    long r = 0;\n";
+    for (unsigned f = 0; f < shape.functions_per_cu; ++f) {
+        out << "    r += f_" << id << '_' << f << "(x);\n";
+    }
+    out << "    return r;\n}\n";
+}
+
+void write_main(const program_shape &shape, const std::string &dir) {
+    std::ofstream out{dir + "/main.cpp"};
+
+    out << "// generated by debugger_bench, do not edit\n\n";
+    for (unsigned cu = 0; cu < shape.compilation_units; ++cu) {
+        out << "extern \"C\" long cu_" << cu << "_call_all(long x);\n";
+    }
+
+    // the benchmarks locate these by symbol name, which is why everything is extern "C",
+    // keep them in sync with bench/main.cpp
+    out << "\nvolatile long bench_sink;\n";
+    out << "unsigned char bench_buffer[" << shape.buffer_size << "];\n\n";
+    out << "extern \"C\" __attribute__((noinline)) long bench_leaf(long x) {\n    return x + 1;\n}\n\n";
+    out << "extern \"C\" __attribute__((noinline)) long bench_recurse(long depth) {\n"
+           "    if (depth == 0) {\n"
+           "        return bench_leaf(depth);\n"
+           "    }\n"
+           "    return bench_recurse(depth - 1) + 1;\n"
+           "}\n\n";
+    out << "extern \"C\" __attribute__((noinline)) long bench_hot(long x) {\n"
+           "    long a = x * 3;\n"
+           "    long b = a + 7;\n"
+           "    long c = a ^ b;\n"
+           "    return c;\n"
+           "}\n\n";
+
+    out << "int main() {\n";
+    out << "    for (unsigned long i = 0; i < sizeof bench_buffer; ++i) {\n";
+    out << "        bench_buffer[i] = static_cast<unsigned char>(i);\n    }\n";
+    out << "    for (long i = 0;; ++i) {\n";
+    out << "        bench_sink = bench_hot(i);\n";
+    out << "        bench_sink = bench_recurse(" << shape.recursion_depth << ");\n";
+    for (unsigned cu = 0; cu < shape.compilation_units; ++cu) {
+        out << "        bench_sink = cu_" << cu << "_call_all(i);\n";
+    }
+    out << "    }\n}\n";
+}
+
+} // namespace
+
+std::string generate_program(const program_shape &shape, const std::string &dir, const std::string &cxx) {
+    mkdir(dir.c_str(), 0755);
+
+    std::string sources;
+    for (unsigned cu = 0; cu < shape.compilation_units; ++cu) {
+        write_compilation_unit(shape, dir, cu);
+        sources += " " + dir + "/cu_" + std::to_string(cu) + ".cpp";
+    }
+    write_main(shape, dir);
+    sources += " " + dir + "/main.cpp";
+
+    // the debugger reads DWARF 4 and doesn't relocate PIE addresses yet, frame pointers are needed by the backtrace walk
+    auto binary = dir + "/inferior";
+    auto command = cxx + " -gdwarf-4 -O0 -no-pie -fno-omit-frame-pointer -o " + binary + sources;
+    if (std::system(command.c_str()) != 0) {
+        throw std::runtime_error{"failed to compile the generated program: " + command};
+    }
+    return binary;
+}
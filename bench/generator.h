@@ -0,0 +1,20 @@
+#ifndef DEBUGGER_BENCH_GENERATOR_H
+#define DEBUGGER_BENCH_GENERATOR_H
+
+#include <cstddef>
+#include <string>
+
+// shape of the synthetic inferior, the defaults give a binary with a few hundred thousand DIEs
+struct program_shape {
+    unsigned compilation_units = 64;
+    unsigned functions_per_cu = 64;
+    unsigned inline_depth = 8;        // every generated function inlines a chain this deep
+    unsigned recursion_depth = 64;    // frames below main when bench_leaf is hit
+    std::size_t buffer_size = 16u << 20; // size of bench_buffer, read by the memory benchmark
+};
+
+// writes the sources of the inferior into dir (one file per compilation unit plus main.cpp)
+// and compiles them into dir/inferior, returns the path of the binary
+std::string generate_program(const program_shape &shape, const std::string &dir, const std::string &cxx);
+
+#endif //DEBUGGER_BENCH_GENERATOR_H
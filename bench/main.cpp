@@ -0,0 +1,348 @@
+#include "../include/debugger.h"
+#include "generator.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <vector>
+#include <wait.h>
+#include <zconf.h>
+
+#ifndef BENCH_CXX
+#define BENCH_CXX "c++"
+#endif
+
+namespace {
+
+struct options {
+    program_shape shape;
+    std::string work_dir = "debugger_bench.d";
+    std::string json_path;
+    std::string cxx = BENCH_CXX;
+    double min_time = 0.5; // seconds spent in each benchmark, at least
+};
+
+struct result {
+    std::string name;
+    std::uint64_t iterations;
+    double ns_per_op;
+    double cpu_ns_per_op; // the debugger's own CPU time, the inferior's isn't counted
+    double items_per_second; // 0 if the benchmark doesn't count items
+};
+
+// CPU time of the whole process, which is what Google Benchmark reports as cpu_time
+double process_cpu_seconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+// the debugger reports everything on stdout, swallow it while measuring
+class null_buffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+class quiet_stdout {
+public:
+    quiet_stdout() : m_saved{std::cout.rdbuf(&m_null)} {}
+
+    ~quiet_stdout() { std::cout.rdbuf(m_saved); }
+
+private:
+    null_buffer m_null;
+    std::streambuf *m_saved;
+};
+
+// runs the benchmarks and prints a line per result, the debugger's own output is swallowed
+class runner {
+public:
+    explicit runner(double min_time) : m_report{std::cout.rdbuf()}, m_min_time{min_time} {}
+
+    // runs op until both min_time and min_iterations are reached (or max_iterations), op returns
+    // the number of items it processed so throughput can be reported
+    void measure(const std::string &name, const std::function<std::uint64_t()> &op,
+                 std::uint64_t min_iterations = 1, std::uint64_t max_iterations = 1000000) {
+        using clock = std::chrono::steady_clock;
+
+        std::uint64_t iterations = 0;
+        std::uint64_t items = 0;
+        auto start = clock::now();
+        auto cpu_start = process_cpu_seconds();
+        std::chrono::duration<double> elapsed{};
+        while (iterations < max_iterations && (iterations < min_iterations || elapsed.count() < m_min_time)) {
+            items += op();
+            ++iterations;
+            elapsed = clock::now() - start;
+        }
+
+        auto cpu = process_cpu_seconds() - cpu_start;
+
+        result r{name, iterations, elapsed.count() * 1e9 / iterations, cpu * 1e9 / iterations,
+                 items ? items / elapsed.count() : 0};
+        m_report << std::left << std::setw(28) << r.name
+                 << std::right << std::setw(10) << r.iterations << " iters "
+                 << std::fixed << std::setprecision(1) << std::setw(14) << r.ns_per_op << " ns/op"
+                 << std::setw(14) << r.cpu_ns_per_op << " cpu ns/op";
+        if (r.items_per_second) {
+            m_report << std::setw(16) << std::setprecision(0) << r.items_per_second << " items/s";
+        }
+        m_report << std::defaultfloat << std::endl;
+        m_results.push_back(r);
+    }
+
+    [[nodiscard]] auto results() const -> const std::vector<result> & {
+        return m_results;
+    }
+
+private:
+    std::ostream m_report; // the real stdout
+    quiet_stdout m_quiet;
+    double m_min_time;
+    std::vector<result> m_results;
+};
+
+// same as src/main.cpp, but the inferior dies with us if a benchmark fails half way
+pid_t launch(const std::string &prog) {
+    auto pid = fork();
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        execl(prog.c_str(), prog.c_str(), nullptr);
+        _exit(127);
+    }
+
+    int wait_status;
+    waitpid(pid, &wait_status, 0);
+    ptrace(PTRACE_SETOPTIONS, pid, nullptr, PTRACE_O_EXITKILL);
+    return pid;
+}
+
+void kill_inferior(pid_t pid) {
+    kill(pid, SIGKILL);
+    int wait_status;
+    waitpid(pid, &wait_status, 0);
+}
+
+std::uintptr_t symbol_address(debugger &dbg, const std::string &name) {
+    auto syms = dbg.lookup_symbol(name);
+    if (syms.empty()) {
+        throw std::runtime_error{"symbol " + name + " not found in the generated program"};
+    }
+    return syms.front().addr;
+}
+
+// address set_breakpoint_at_function picks for a function: the line after the prologue
+std::intptr_t breakpoint_address(debugger &dbg, std::uintptr_t function) {
+    auto entry = dbg.get_line_entry_from_pc(function);
+    ++entry;
+    return entry->address;
+}
+
+std::string function_name(const program_shape &shape, unsigned i) {
+    auto cu = i % shape.compilation_units;
+    auto f = (i / shape.compilation_units) % shape.functions_per_cu;
+    return "f_" + std::to_string(cu) + "_" + std::to_string(f);
+}
+
+std::vector<result> run_benchmarks(const options &opts, const std::string &binary) {
+    runner bench{opts.min_time};
+    auto pid = launch(binary);
+    const auto &shape = opts.shape;
+
+    // startup: ELF/DWARF loading, then the first lookup which pays for indexing every unit
+    bench.measure("startup/construct", [&] {
+        debugger dbg{binary, pid};
+        return 0;
+    }, 3, 1000);
+    bench.measure("startup/first_lookup", [&] {
+        debugger dbg{binary, pid};
+        dbg.set_breakpoint_at_function("no_such_function");
+        return 0;
+    }, 3, 1000);
+
+    debugger dbg{binary, pid};
+    dbg.set_breakpoint_at_function("no_such_function");
+
+    auto n_functions = shape.compilation_units * shape.functions_per_cu;
+    std::vector<std::uintptr_t> pcs;
+    for (unsigned i = 0; i < std::min(n_functions, 1024u); ++i) {
+        pcs.push_back(symbol_address(dbg, function_name(shape, i)) + 4);
+    }
+
+    std::size_t next_pc = 0;
+    bench.measure("pc_to_line", [&] {
+        dbg.get_line_entry_from_pc(pcs[next_pc++ % pcs.size()]);
+        return 1;
+    });
+    bench.measure("pc_to_function", [&] {
+        dbg.get_function_from_pc(pcs[next_pc++ % pcs.size()]);
+        return 1;
+    });
+
+    unsigned next_name = 0;
+    bench.measure("name_lookup/symbol", [&] {
+        dbg.lookup_symbol(function_name(shape, next_name++));
+        return 1;
+    });
+    bench.measure("name_lookup/function", [&] {
+        auto name = function_name(shape, next_name++);
+        dbg.set_breakpoint_at_function(name);
+        dbg.remove_breakpoint(breakpoint_address(dbg, symbol_address(dbg, name)));
+        return 1;
+    }, 1, 10000);
+
+    // breakpoint round trip: cont from one bench_hot hit to the next, one main loop iteration apart
+    dbg.set_breakpoint_at_function("bench_hot");
+    bench.measure("breakpoint/round_trip", [&] {
+        dbg.handle_command("cont");
+        return 1;
+    }, 10, 100000);
+    dbg.remove_breakpoint(dbg.get_pc());
+
+    bench.measure("step/step", [&] {
+        dbg.handle_command("step");
+        return 1;
+    }, 10, 10000);
+    bench.measure("step/next", [&] {
+        dbg.handle_command("next");
+        return 1;
+    }, 10, 10000);
+
+    // memory read throughput, one word per read_memory call over bench_buffer
+    auto buffer = symbol_address(dbg, "bench_buffer");
+    std::size_t offset = 0;
+    const std::size_t chunk = 64 * 1024;
+    bench.measure("memory/read", [&] {
+        for (std::size_t i = 0; i < chunk; i += sizeof(uint64_t)) {
+            dbg.read_memory(buffer + (offset + i) % shape.buffer_size);
+        }
+        offset += chunk;
+        return chunk;
+    }, 1, 100000);
+
+    // the same with one bulk read_memory call per chunk, as the find commands and the gdb server's m and x do
+    std::vector<std::uint8_t> bulk(chunk);
+    offset = 0;
+    bench.measure("memory/read_bulk", [&] {
+        auto size = std::min(chunk, shape.buffer_size - offset);
+        auto n = dbg.read_memory(buffer + offset, bulk.data(), size);
+        offset = (offset + size) % shape.buffer_size;
+        return n;
+    }, 1, 100000);
+
+    // backtrace from recursion_depth frames deep: follow the frame pointer chain and look up
+    // the function of every return address
+    dbg.set_breakpoint_at_function("bench_leaf");
+    dbg.handle_command("cont");
+    bench.measure("backtrace/frame_walk", [&] {
+        user_regs_struct regs{};
+        ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+
+        std::uint64_t frames = 1;
+        dbg.get_function_from_pc(regs.rip);
+        for (auto frame = regs.rbp; frame;) {
+            auto return_address = dbg.read_memory(frame + 8);
+            try {
+                dbg.get_function_from_pc(return_address);
+            } catch (std::out_of_range &) {
+                break; // left the program, e.g. __libc_start_call_main
+            }
+            ++frames;
+            frame = dbg.read_memory(frame);
+        }
+        return frames;
+    }, 10, 100000);
+
+    kill_inferior(pid);
+    return bench.results();
+}
+
+void write_json(const options &opts, const std::vector<result> &results) {
+    // the layout follows Google Benchmark's --benchmark_format=json, so its compare.py works on it
+    std::ofstream out{opts.json_path};
+    out << std::setprecision(12);
+    const auto &shape = opts.shape;
+    out << "{\n  \"context\": {\n"
+        << "    \"compilation_units\": " << shape.compilation_units << ",\n"
+        << "    \"functions_per_cu\": " << shape.functions_per_cu << ",\n"
+        << "    \"inline_depth\": " << shape.inline_depth << ",\n"
+        << "    \"recursion_depth\": " << shape.recursion_depth << ",\n"
+        << "    \"buffer_size\": " << shape.buffer_size << "\n"
+        << "  },\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"run_name\": \"" << r.name
+            << "\", \"run_type\": \"iteration\", \"repetitions\": 1, \"threads\": 1"
+            << ", \"iterations\": " << r.iterations << ", \"real_time\": " << r.ns_per_op
+            << ", \"cpu_time\": " << r.cpu_ns_per_op << ", \"time_unit\": \"ns\"";
+        if (r.items_per_second) {
+            out << ", \"items_per_second\": " << r.items_per_second;
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void usage(const char *prog) {
+    std::cerr << "usage: " << prog << " [--cus N] [--functions N] [--inline-depth N] [--recursion-depth N]\n"
+              << "       [--buffer-size BYTES] [--min-time SECONDS] [--work-dir DIR] [--cxx COMPILER] [--json FILE]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    options opts;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            usage(argv[0]);
+            return -1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--cus") {
+            opts.shape.compilation_units = std::stoul(value);
+        } else if (arg == "--functions") {
+            opts.shape.functions_per_cu = std::stoul(value);
+        } else if (arg == "--inline-depth") {
+            opts.shape.inline_depth = std::stoul(value);
+        } else if (arg == "--recursion-depth") {
+            opts.shape.recursion_depth = std::stoul(value);
+        } else if (arg == "--buffer-size") {
+            opts.shape.buffer_size = std::stoul(value);
+        } else if (arg == "--min-time") {
+            opts.min_time = std::stod(value);
+        } else if (arg == "--work-dir") {
+            opts.work_dir = value;
+        } else if (arg == "--cxx") {
+            opts.cxx = value;
+        } else if (arg == "--json") {
+            opts.json_path = value;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (!opts.shape.compilation_units || !opts.shape.functions_per_cu || !opts.shape.buffer_size) {
+        std::cerr << "--cus, --functions and --buffer-size must be positive\n";
+        return -1;
+    }
+
+    try {
+        auto binary = generate_program(opts.shape, opts.work_dir, opts.cxx);
+        auto results = run_benchmarks(opts, binary);
+        if (!opts.json_path.empty()) {
+            write_json(opts, results);
+        }
+    } catch (std::exception &e) {
+        std::cerr << "debugger_bench: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -215,6 +215,12 @@ enum class DW_AT
 
         lo_user              = 0x2000,
         hi_user              = 0x3fff,
+
+        // GNU split DWARF extensions
+        GNU_dwo_name         = 0x2130, // string
+        GNU_dwo_id           = 0x2131, // constant
+        GNU_ranges_base      = 0x2132, // constant
+        GNU_addr_base        = 0x2133, // constant
 };
 
 std::string
@@ -251,6 +257,10 @@ enum class DW_FORM
         exprloc      = 0x18,    // exprloc
         flag_present = 0x19,    // flag
         ref_sig8     = 0x20,    // reference
+
+        // GNU split DWARF extensions
+        GNU_addr_index = 0x1f01, // address
+        GNU_str_index  = 0x1f02, // string
 };
 
 std::string
@@ -339,6 +349,10 @@ enum class DW_OP : ubyte
 
         lo_user             = 0xe0,
         hi_user             = 0xff,
+
+        // GNU split DWARF extensions
+        GNU_addr_index      = 0xfb, // [ULEB128 index into .debug_addr]
+        GNU_const_index     = 0xfc, // [ULEB128 index into .debug_addr]
 };
 
 std::string
@@ -0,0 +1,242 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+const die_table::index die_table::npos;
+
+struct die_table::impl
+{
+        const unit *cu;
+
+        // Per-DIE arrays, all indexed by die_table::index.  The
+        // attributes of DIE i are attr_offsets[attr_start[i]] through
+        // attr_offsets[attr_start[i] + abbrevs[i]->attributes.size()].
+        vector<section_offset> offsets;
+        vector<DW_TAG> tags;
+        vector<index> parents;
+        vector<index> siblings;
+        vector<const abbrev_entry*> abbrevs;
+        vector<uint32_t> attr_start;
+
+        // Offsets of all attributes of all DIEs, relative to cu's
+        // subsection.
+        vector<section_offset> attr_offsets;
+
+        // Cached sections, so string lookups don't need to go
+        // through the dwarf object.
+        shared_ptr<section> info, str;
+
+        impl(const unit &u);
+
+        int find_attr(index i, DW_AT attr) const
+        {
+                int j = 0;
+                for (auto &a : abbrevs[i]->attributes) {
+                        if (a.name == attr)
+                                return j;
+                        j++;
+                }
+                return -1;
+        }
+};
+
+die_table::impl::impl(const unit &u)
+        : cu(&u), info(u.data())
+{
+        // DIEs are rarely smaller than a dozen bytes or so, so this
+        // usually gets the arrays close to their final size without
+        // overshooting by much.
+        size_t guess = info->size() / 16;
+        offsets.reserve(guess);
+        tags.reserve(guess);
+        parents.reserve(guess);
+        siblings.reserve(guess);
+        abbrevs.reserve(guess);
+        attr_start.reserve(guess);
+        attr_offsets.reserve(guess * 4);
+
+        // open is the stack of DIEs whose children we're reading.
+        // prev[n] is the last DIE seen at depth n, whose sibling
+        // pointer is filled in when the next sibling shows up.
+        vector<index> open, prev(1, npos);
+        cursor cur(info, u.root().get_unit_offset());
+        while (!cur.end()) {
+                section_offset off = cur.get_section_offset();
+                abbrev_code acode = cur.uleb128();
+                if (acode == 0) {
+                        // Sibling list terminator
+                        if (open.empty())
+                                break;
+                        open.pop_back();
+                        prev.pop_back();
+                        if (open.empty())
+                                break;
+                        continue;
+                }
+                const abbrev_entry *abbrev = &u.get_abbrev(acode);
+
+                index i = offsets.size();
+                offsets.push_back(off);
+                tags.push_back(abbrev->tag);
+                parents.push_back(open.empty() ? npos : open.back());
+                siblings.push_back(npos);
+                abbrevs.push_back(abbrev);
+                attr_start.push_back(attr_offsets.size());
+                if (prev.back() != npos)
+                        siblings[prev.back()] = i;
+                prev.back() = i;
+
+                for (auto &attr : abbrev->attributes) {
+                        attr_offsets.push_back(cur.get_section_offset());
+                        cur.skip_form(attr.form);
+                }
+
+                if (abbrev->children) {
+                        open.push_back(i);
+                        prev.push_back(npos);
+                } else if (open.empty()) {
+                        // A childless root; nothing else to read
+                        break;
+                }
+        }
+
+        try {
+                str = u.get_dwarf().get_section(section_type::str);
+        } catch (format_error &e) {
+                // Only DW_FORM::string strings are available
+        }
+}
+
+die_table::die_table(const unit &u)
+        : m(make_shared<impl>(u))
+{
+}
+
+die_table::index
+die_table::size() const
+{
+        return m->offsets.size();
+}
+
+size_t
+die_table::memory_size() const
+{
+        return sizeof(impl) +
+                m->offsets.capacity() * sizeof(section_offset) +
+                m->tags.capacity() * sizeof(DW_TAG) +
+                m->parents.capacity() * sizeof(index) +
+                m->siblings.capacity() * sizeof(index) +
+                m->abbrevs.capacity() * sizeof(const abbrev_entry*) +
+                m->attr_start.capacity() * sizeof(uint32_t) +
+                m->attr_offsets.capacity() * sizeof(section_offset);
+}
+
+DW_TAG
+die_table::tag(index i) const
+{
+        return m->tags[i];
+}
+
+section_offset
+die_table::get_unit_offset(index i) const
+{
+        return m->offsets[i];
+}
+
+die_table::index
+die_table::parent(index i) const
+{
+        return m->parents[i];
+}
+
+die_table::index
+die_table::first_child(index i) const
+{
+        // Children immediately follow their parent in pre-order
+        if (i + 1 < size() && m->parents[i + 1] == i)
+                return i + 1;
+        return npos;
+}
+
+die_table::index
+die_table::sibling(index i) const
+{
+        return m->siblings[i];
+}
+
+bool
+die_table::has(index i, DW_AT attr) const
+{
+        return m->find_attr(i, attr) >= 0;
+}
+
+value
+die_table::get(index i, DW_AT attr) const
+{
+        int j = m->find_attr(i, attr);
+        if (j < 0)
+                throw out_of_range("DIE does not have attribute " + to_string(attr));
+        auto &a = m->abbrevs[i]->attributes[j];
+        return value(m->cu, a.name, a.form, a.type,
+                     m->attr_offsets[m->attr_start[i] + j]);
+}
+
+const char *
+die_table::get_cstr(index i, DW_AT attr, size_t *size_out) const
+{
+        int j = m->find_attr(i, attr);
+        if (j < 0)
+                return nullptr;
+        auto &a = m->abbrevs[i]->attributes[j];
+        cursor cur(m->info, m->attr_offsets[m->attr_start[i] + j]);
+        switch (a.form) {
+        case DW_FORM::string:
+                return cur.cstr(size_out);
+        case DW_FORM::strp: {
+                if (!m->str)
+                        return nullptr;
+                cursor scur(m->str, cur.offset());
+                return scur.cstr(size_out);
+        }
+        case DW_FORM::GNU_str_index:
+                return m->cu->get_indexed_str(cur.uleb128(), size_out);
+        case DW_FORM::indirect: {
+                value v(get(i, attr));
+                if (v.get_type() != value::type::string)
+                        return nullptr;
+                return v.as_cstr(size_out);
+        }
+        default:
+                return nullptr;
+        }
+}
+
+die
+die_table::get_die(index i) const
+{
+        die d(m->cu);
+        d.read(m->offsets[i]);
+        return d;
+}
+
+die_table::index
+die_table::find(section_offset unit_offset) const
+{
+        // DIEs are stored in section order
+        auto it = lower_bound(m->offsets.begin(), m->offsets.end(),
+                              unit_offset);
+        if (it == m->offsets.end() || *it != unit_offset)
+                return npos;
+        return it - m->offsets.begin();
+}
+
+DWARFPP_END_NAMESPACE
@@ -13,6 +13,7 @@
 #include "data.hh"
 #include "small_vector.hh"
 
+#include <functional>
 #include <initializer_list>
 #include <map>
 #include <memory>
@@ -28,6 +29,7 @@ class loader;
 class compilation_unit;
 class type_unit;
 class die;
+class die_table;
 class value;
 class expr;
 class expr_context;
@@ -92,6 +94,11 @@ enum class section_type
         ranges,
         str,
         types,
+
+        // Split DWARF (GNU extensions to DWARF 4)
+        addr,
+        str_offsets,
+        cu_index,
 };
 
 std::string
@@ -159,6 +166,25 @@ public:
          */
         const type_unit &get_type_unit(uint64_t type_signature) const;
 
+        /**
+         * A function that opens the split DWARF file (.dwo) at the
+         * given path and returns a loader for its sections, or
+         * nullptr if it cannot be opened.
+         */
+        typedef std::function<std::shared_ptr<loader>(const std::string &path)>
+                dwo_opener;
+
+        /**
+         * Set how this file finds the split units of its skeleton
+         * compilation units.  package is a loader for the DWARF
+         * package (.dwp) that collects them and is searched first;
+         * open_dwo opens the .dwo file a skeleton names.  Either may
+         * be null.  Split units are only read on first use, see
+         * compilation_unit::get_split_unit.
+         */
+        void set_split_dwarf(const std::shared_ptr<loader> &package,
+                             const dwo_opener &open_dwo);
+
         /**
          * \internal Retrieve the specified section from this file.
          * If the section does not exist, throws format_error.
@@ -166,8 +192,22 @@ public:
         std::shared_ptr<section> get_section(section_type type) const;
 
 private:
+        friend class compilation_unit;
+
         struct impl;
         std::shared_ptr<impl> m;
+
+        /**
+         * Construct a DWARF file from a .dwo file or .dwp package.
+         * Its units are not enumerated, they are looked up by the
+         * skeletons that refer to them.
+         */
+        dwarf(const std::shared_ptr<loader> &l, bool read_units);
+
+        dwarf find_split_file(const die &skeleton, uint64_t dwo_id,
+                              section_offset *info_off,
+                              section_offset *abbrev_base,
+                              section_offset *str_offsets_base) const;
 };
 
 /**
@@ -236,6 +276,26 @@ public:
          */
         const die &root() const;
 
+        /**
+         * Return the flattened DIE table of this unit.  The table is
+         * built on first use and kept live by the unit.
+         */
+        const die_table &get_die_table() const;
+
+        /**
+         * Return the number of bytes of memory this unit holds for
+         * what has been read from it so far: its abbrevs and DIE
+         * table and, for a skeleton unit, its split unit.  Section
+         * data isn't counted, it belongs to the loader.
+         */
+        size_t memory_size() const;
+
+        /**
+         * Return the number of DIEs in this unit (its split unit's
+         * for a skeleton), or 0 if its DIE table hasn't been built.
+         */
+        size_t indexed_dies() const;
+
         /**
          * \internal Return the data for this unit.
          */
@@ -247,6 +307,26 @@ public:
          */
         const abbrev_entry &get_abbrev(std::uint64_t acode) const;
 
+        /**
+         * \internal Return the address at the given index into this
+         * unit's part of .debug_addr (DW_FORM::GNU_addr_index).
+         */
+        taddr get_indexed_address(std::uint64_t index) const;
+
+        /**
+         * \internal Return the string at the given index into this
+         * unit's part of .debug_str_offsets (DW_FORM::GNU_str_index).
+         */
+        const char *get_indexed_str(std::uint64_t index,
+                                    size_t *size_out = nullptr) const;
+
+        /**
+         * \internal Return the range list at the given offset,
+         * which for a split unit is relative to its skeleton's base
+         * in the skeleton's .debug_ranges.
+         */
+        rangelist get_rangelist(section_offset offset) const;
+
 protected:
         friend struct ::std::hash<unit>;
         struct impl;
@@ -280,6 +360,27 @@ public:
          * table.
          */
         const line_table &get_line_table() const;
+
+        /**
+         * Return the unit that holds the DIEs of this unit.  With
+         * split DWARF this is a skeleton unit that only describes
+         * its address ranges and line table, and the DIEs are in a
+         * split unit in a .dwo file or .dwp package, which is read
+         * on first use (see dwarf::set_split_dwarf).  The split unit
+         * uses the skeleton's line table.  For any other unit, or if
+         * the split unit cannot be found, returns this unit.
+         */
+        const compilation_unit &get_split_unit() const;
+
+        /**
+         * Return what get_split_unit returns without reading
+         * anything: nullptr for a skeleton unit whose split unit
+         * hasn't been looked for yet.
+         */
+        const compilation_unit *peek_split_unit() const;
+
+private:
+        void read_split_unit() const;
 };
 
 /**
@@ -423,6 +524,7 @@ private:
         friend class unit;
         friend class type_unit;
         friend class value;
+        friend class die_table;
         // XXX If we can get the CU, we don't need this
         friend struct ::std::hash<die>;
 
@@ -703,6 +805,7 @@ public:
 
 private:
         friend class die;
+        friend class die_table;
 
         value(const unit *cu,
               DW_AT name, DW_FORM form, type typ, section_offset offset);
@@ -1478,6 +1581,129 @@ private:
         std::shared_ptr<impl> m;
 };
 
+/**
+ * A flattened, read-only table of all of the DIEs in a unit.
+ *
+ * Where die::iterator decodes each DIE into a temporary die object
+ * as it goes, a die_table decodes the whole unit once and stores the
+ * result in parallel arrays indexed by DIE position in pre-order.
+ * Scanning the table, querying the tree structure, and reading
+ * string attributes never allocate, which makes full-tree scans
+ * (e.g., looking up a function by name) cheap.  Sibling list
+ * terminators are not stored.
+ *
+ * This class is internally reference counted and can be efficiently
+ * copied.  Like die, it depends on its unit staying live.
+ */
+class die_table
+{
+public:
+        typedef std::uint32_t index;
+
+        /**
+         * The index used for "no such DIE", e.g., the parent of the
+         * root DIE.
+         */
+        static const index npos = ~(index)0;
+
+        /**
+         * Construct the table of all DIEs in u.
+         */
+        explicit die_table(const unit &u);
+
+        die_table() = default;
+        die_table(const die_table &o) = default;
+        die_table(die_table &&o) = default;
+
+        die_table& operator=(const die_table &o) = default;
+        die_table& operator=(die_table &&o) = default;
+
+        /**
+         * Return true if this object represents a DIE table.
+         * Default constructed tables are not valid.
+         */
+        bool valid() const
+        {
+                return !!m;
+        }
+
+        /**
+         * Return the number of DIEs in this table.  The root DIE of
+         * the unit is at index 0.
+         */
+        index size() const;
+
+        /**
+         * Return the number of bytes of memory this table holds,
+         * not counting the section data it points into.
+         */
+        size_t memory_size() const;
+
+        /**
+         * Return the tag of DIE i.
+         */
+        DW_TAG tag(index i) const;
+
+        /**
+         * Return the byte offset of DIE i within its unit.
+         */
+        section_offset get_unit_offset(index i) const;
+
+        /**
+         * Return the parent of DIE i, or npos for the root.
+         */
+        index parent(index i) const;
+
+        /**
+         * Return the first child of DIE i, or npos if it has no
+         * children.
+         */
+        index first_child(index i) const;
+
+        /**
+         * Return the next sibling of DIE i, or npos if it is the
+         * last of its siblings.
+         */
+        index sibling(index i) const;
+
+        /**
+         * Return true if DIE i has the requested attribute.
+         */
+        bool has(index i, DW_AT attr) const;
+
+        /**
+         * Return the value of attr of DIE i.  Throws out_of_range if
+         * the DIE does not have the specified attribute.
+         */
+        value get(index i, DW_AT attr) const;
+
+        /**
+         * Return the string value of attr of DIE i as a
+         * NUL-terminated character string pointing directly into the
+         * section data (.debug_info or .debug_str).  *size_out, if
+         * not NULL, is set to the length of the string without the
+         * NUL-terminator.  Returns nullptr if the DIE does not have
+         * the attribute or the attribute is not a string.
+         */
+        const char *get_cstr(index i, DW_AT attr,
+                             size_t *size_out = nullptr) const;
+
+        /**
+         * Return the DIE at index i.
+         */
+        die get_die(index i) const;
+
+        /**
+         * Return the index of the DIE at the given unit offset, or
+         * npos if no DIE begins at that offset.
+         */
+        index find(section_offset unit_offset) const;
+
+private:
+        struct impl;
+        std::shared_ptr<impl> m;
+};
+
 //////////////////////////////////////////////////////////////////
 // ELF support
 //
@@ -1506,11 +1732,16 @@ namespace elf
 
                 const void *load(section_type section, size_t *size_out)
                 {
-                        auto sec = f.get_section(section_type_to_name(section));
-                        if (!sec.valid())
+                        const char *name = section_type_to_name(section);
+                        auto *sec = &f.get_section(name);
+                        // Split DWARF files (.dwo and .dwp) name their
+                        // sections with a .dwo suffix
+                        if (!sec->valid())
+                                sec = &f.get_section(std::string(name) + ".dwo");
+                        if (!sec->valid())
                                 return nullptr;
-                        *size_out = sec.size();
-                        return sec.data();
+                        *size_out = sec->size();
+                        return sec->data();
                 }
         };
 
@@ -28,9 +28,18 @@ struct dwarf::impl
         bool have_type_units;
 
         std::map<section_type, std::shared_ptr<section> > sections;
+
+        // Where the split units of skeleton units are
+        dwarf package;
+        dwo_opener open_dwo;
 };
 
 dwarf::dwarf(const std::shared_ptr<loader> &l)
+        : dwarf(l, true)
+{
+}
+
+dwarf::dwarf(const std::shared_ptr<loader> &l, bool read_units)
         : m(make_shared<impl>(l))
 {
         const void *data;
@@ -63,6 +72,8 @@ dwarf::dwarf(const std::shared_ptr<loader> &l)
 
         // Get compilation units.  Everything derives from these, so
         // there's no point in doing it lazily.
+        if (!read_units)
+                return;
         cursor infocur(m->sec_info);
         while (!infocur.end()) {
                 // XXX Circular reference.  Given that we now require
@@ -122,10 +133,118 @@ dwarf::get_section(section_type type) const
         if (!data)
                 throw format_error(std::string(elf::section_type_to_name(type))
                                    + " section missing");
-        m->sections[type] = std::make_shared<section>(section_type::str, data, size, m->sec_info->ord);
+        m->sections[type] = std::make_shared<section>(type, data, size, m->sec_info->ord);
         return m->sections[type];
 }
 
+void
+dwarf::set_split_dwarf(const std::shared_ptr<loader> &package,
+                       const dwo_opener &open_dwo)
+{
+        m->package = package ? dwarf(package, false) : dwarf();
+        m->open_dwo = open_dwo;
+}
+
+/**
+ * Look up a unit in the index of a DWARF package (.debug_cu_index).
+ * Sets *info_off to the offset of the unit in .debug_info.dwo and
+ * *abbrev_base and *str_offsets_base to the start of its parts of
+ * .debug_abbrev.dwo and .debug_str_offsets.dwo.
+ */
+static bool
+find_in_cu_index(const std::shared_ptr<section> &index, uint64_t dwo_id,
+                 section_offset *info_off, section_offset *abbrev_base,
+                 section_offset *str_offsets_base)
+{
+        // Version 2 of the index format, which gcc's dwp and
+        // llvm-dwp write for DWARF 4
+        cursor cur(index);
+        uword version = cur.fixed<uword>();
+        if (version != 2)
+                throw format_error("unknown .debug_cu_index version " + std::to_string(version));
+        uword columns = cur.fixed<uword>();
+        uword units = cur.fixed<uword>();
+        uword slots = cur.fixed<uword>();
+        if (slots == 0 || (slots & (slots - 1)))
+                throw format_error("bad .debug_cu_index slot count");
+        cursor sigs(index, cur.get_section_offset());
+        cursor rows(index, cur.get_section_offset() + slots * 8);
+
+        // Open addressing with the low bits of the ID as the hash
+        // and the high bits (made odd) as the step
+        uword mask = slots - 1;
+        uword slot = dwo_id & mask, step = ((dwo_id >> 32) & mask) | 1;
+        uword row = 0;
+        for (uword probe = 0; probe < slots; probe++, slot = (slot + step) & mask) {
+                cursor sig(index, sigs.get_section_offset() + slot * 8);
+                uint64_t id = sig.fixed<uint64_t>();
+                cursor r(index, rows.get_section_offset() + slot * 4);
+                uword found = r.fixed<uword>();
+                if (found == 0)
+                        return false;
+                if (id == dwo_id) {
+                        row = found;
+                        break;
+                }
+        }
+        if (row == 0 || row > units)
+                return false;
+
+        // The column headers say which section each column is for,
+        // followed by the offsets and then the sizes of each row
+        section_offset ids = rows.get_section_offset() + slots * 4;
+        section_offset offsets = ids + columns * 4;
+        bool have_info = false;
+        *abbrev_base = *str_offsets_base = 0;
+        for (uword col = 0; col < columns; col++) {
+                cursor id(index, ids + col * 4);
+                cursor off(index, offsets + ((row - 1) * columns + col) * 4);
+                uword sect = id.fixed<uword>(), value = off.fixed<uword>();
+                switch (sect) {
+                case 1: // DW_SECT_INFO
+                        *info_off = value;
+                        have_info = true;
+                        break;
+                case 3: // DW_SECT_ABBREV
+                        *abbrev_base = value;
+                        break;
+                case 6: // DW_SECT_STR_OFFSETS
+                        *str_offsets_base = value;
+                        break;
+                }
+        }
+        return have_info;
+}
+
+dwarf
+dwarf::find_split_file(const die &skeleton, uint64_t dwo_id,
+                       section_offset *info_off, section_offset *abbrev_base,
+                       section_offset *str_offsets_base) const
+{
+        *info_off = *abbrev_base = *str_offsets_base = 0;
+        if (m->package.valid()) {
+                try {
+                        if (find_in_cu_index(
+                                    m->package.get_section(section_type::cu_index),
+                                    dwo_id, info_off, abbrev_base,
+                                    str_offsets_base))
+                                return m->package;
+                } catch (format_error &e) {
+                }
+        }
+        if (m->open_dwo && skeleton.has(DW_AT::GNU_dwo_name)) {
+                // The name is relative to the compilation directory
+                std::string path = skeleton[DW_AT::GNU_dwo_name].as_string();
+                if (!path.empty() && path[0] != '/' && skeleton.has(DW_AT::comp_dir))
+                        path = at_comp_dir(skeleton) + "/" + path;
+                // A .dwo holds the split unit of one skeleton
+                auto l = m->open_dwo(path);
+                if (l)
+                        return dwarf(l, false);
+        }
+        return dwarf();
+}
+
 //////////////////////////////////////////////////////////////////
 // class unit
 //
@@ -138,7 +257,7 @@ struct unit::impl
         const dwarf file;
         const section_offset offset;
         const std::shared_ptr<section> subsec;
-        const section_offset debug_abbrev_offset;
+        section_offset debug_abbrev_offset;
         const section_offset root_offset;
 
         // Type unit-only values
@@ -151,6 +270,23 @@ struct unit::impl
         // Lazily constructed line table
         line_table lt;
 
+        // Lazily constructed DIE table
+        die_table dies;
+
+        // Split DWARF.  For a skeleton unit, the split unit that
+        // holds its DIEs, found on first use.  For a split unit, the
+        // skeleton's sections and bases that its address indexes and
+        // range lists refer to.
+        bool have_split;
+        compilation_unit split;
+        bool is_split;
+        section_offset str_offsets_base;
+        std::shared_ptr<section> sec_addr;
+        section_offset addr_base;
+        std::shared_ptr<section> sec_ranges;
+        section_offset ranges_base;
+        taddr base_address;
+
         // Map from abbrev code to abbrev.  If the map is dense, it
         // will be stored in the vector; otherwise it will be stored
         // in the map.
@@ -165,7 +301,9 @@ struct unit::impl
                 : file(file), offset(offset), subsec(subsec),
                   debug_abbrev_offset(debug_abbrev_offset),
                   root_offset(root_offset), type_signature(type_signature),
-                  type_offset(type_offset), have_abbrevs(false) { }
+                  type_offset(type_offset), have_split(false),
+                  is_split(false), str_offsets_base(0), addr_base(0),
+                  ranges_base(0), base_address(0), have_abbrevs(false) { }
 
         void force_abbrevs();
 };
@@ -197,6 +335,41 @@ unit::root() const
         return m->root;
 }
 
+const die_table &
+unit::get_die_table() const
+{
+        if (!m->dies.valid())
+                m->dies = die_table(*this);
+        return m->dies;
+}
+
+size_t
+unit::memory_size() const
+{
+        size_t size = sizeof(impl);
+        if (m->dies.valid())
+                size += m->dies.memory_size();
+        size += m->abbrevs_vec.capacity() * sizeof(abbrev_entry);
+        for (auto &entry : m->abbrevs_vec)
+                size += entry.attributes.capacity() * sizeof(attribute_spec);
+        // Roughly a node and a bucket per map entry
+        size += m->abbrevs_map.size() *
+                (sizeof(pair<const abbrev_code, abbrev_entry>) + 3 * sizeof(void*));
+        for (auto &entry : m->abbrevs_map)
+                size += entry.second.attributes.capacity() * sizeof(attribute_spec);
+        if (m->split.valid())
+                size += m->split.memory_size();
+        return size;
+}
+
+size_t
+unit::indexed_dies() const
+{
+        if (m->split.valid())
+                return m->split.indexed_dies();
+        return m->dies.valid() ? m->dies.size() : 0;
+}
+
 const std::shared_ptr<section> &
 unit::data() const
 {
@@ -227,6 +400,64 @@ unknown:
         throw format_error("unknown abbrev code 0x" + to_hex(acode));
 }
 
+taddr
+unit::get_indexed_address(uint64_t index) const
+{
+        if (!m->sec_addr) {
+                // A split unit gets these from its skeleton.  Any
+                // other unit has its own base, if it has one.
+                m->sec_addr = m->file.get_section(section_type::addr);
+                const die &d = root();
+                if (d.has(DW_AT::GNU_addr_base))
+                        m->addr_base = d[DW_AT::GNU_addr_base].as_sec_offset();
+        }
+        cursor cur(m->sec_addr, m->addr_base + index * m->subsec->addr_size);
+        switch (m->subsec->addr_size) {
+        case 4:
+                return cur.fixed<uint32_t>();
+        case 8:
+                return cur.fixed<uint64_t>();
+        default:
+                throw format_error("address size " + std::to_string(m->subsec->addr_size) + " not supported");
+        }
+}
+
+const char *
+unit::get_indexed_str(uint64_t index, size_t *size_out) const
+{
+        auto sec = m->file.get_section(section_type::str_offsets);
+        section_offset off;
+        if (m->subsec->fmt == format::dwarf64) {
+                cursor cur(sec, m->str_offsets_base + index * 8);
+                off = cur.fixed<uint64_t>();
+        } else {
+                cursor cur(sec, m->str_offsets_base + index * 4);
+                off = cur.fixed<uint32_t>();
+        }
+        cursor scur(m->file.get_section(section_type::str), off);
+        return scur.cstr(size_out);
+}
+
+rangelist
+unit::get_rangelist(section_offset offset) const
+{
+        if (m->is_split) {
+                if (!m->sec_ranges)
+                        throw format_error(".debug_ranges section missing");
+                return rangelist(m->sec_ranges, m->ranges_base + offset,
+                                 m->subsec->addr_size, m->base_address);
+        }
+
+        // The compilation unit may not have a base address.  In this
+        // case, the first entry in the range list must be a base
+        // address entry, but we'll just assume 0 for the initial base
+        // address.
+        const die &cudie = root();
+        taddr cu_low_pc = cudie.has(DW_AT::low_pc) ? at_low_pc(cudie) : 0;
+        return rangelist(m->file.get_section(section_type::ranges), offset,
+                         m->subsec->addr_size, cu_low_pc);
+}
+
 void
 unit::impl::force_abbrevs()
 {
@@ -289,7 +520,7 @@ compilation_unit::get_line_table() const
 {
         if (!m->lt.valid()) {
                 const die &d = root();
-                if (!d.has(DW_AT::stmt_list) || !d.has(DW_AT::name))
+                if (!d.has(DW_AT::stmt_list))
                         goto done;
 
                 shared_ptr<section> sec;
@@ -300,15 +531,86 @@ compilation_unit::get_line_table() const
                 }
 
                 auto comp_dir = d.has(DW_AT::comp_dir) ? at_comp_dir(d) : "";
+                // Skeleton units of split DWARF have no name, it is
+                // only used for file 0, which DWARF 4 doesn't refer to
+                auto name = d.has(DW_AT::name) ? at_name(d) : "";
                 
                 m->lt = line_table(sec, d[DW_AT::stmt_list].as_sec_offset(),
-                                   m->subsec->addr_size, comp_dir,
-                                   at_name(d));
+                                   m->subsec->addr_size, comp_dir, name);
         }
 done:
         return m->lt;
 }
 
+const compilation_unit &
+compilation_unit::get_split_unit() const
+{
+        if (!m->have_split) {
+                m->have_split = true;
+                // A missing or malformed split unit leaves the
+                // skeleton, which still has the ranges and lines
+                try {
+                        read_split_unit();
+                } catch (runtime_error &e) {
+                        m->split = compilation_unit();
+                }
+        }
+        return m->split.valid() ? m->split : *this;
+}
+
+const compilation_unit *
+compilation_unit::peek_split_unit() const
+{
+        if (m->have_split)
+                return m->split.valid() ? &m->split : this;
+        return root().has(DW_AT::GNU_dwo_id) ? nullptr : this;
+}
+
+void
+compilation_unit::read_split_unit() const
+{
+        const die &root = this->root();
+        if (!root.has(DW_AT::GNU_dwo_id))
+                return;
+        uint64_t dwo_id = root[DW_AT::GNU_dwo_id].as_uconstant();
+
+        section_offset info_off, abbrev_base, str_offsets_base;
+        dwarf file = m->file.find_split_file(root, dwo_id, &info_off,
+                                             &abbrev_base, &str_offsets_base);
+        if (!file.valid())
+                return;
+
+        // DIEs point back to their unit, so build the split unit
+        // where it stays
+        m->split = compilation_unit(file, info_off);
+        auto &split = m->split.m;
+        split->debug_abbrev_offset += abbrev_base;
+        split->str_offsets_base = str_offsets_base;
+
+        // Addresses, range lists and the line table are in the
+        // skeleton's file
+        split->is_split = true;
+        try {
+                split->sec_addr = m->file.get_section(section_type::addr);
+        } catch (format_error &e) {
+        }
+        if (root.has(DW_AT::GNU_addr_base))
+                split->addr_base = root[DW_AT::GNU_addr_base].as_sec_offset();
+        try {
+                split->sec_ranges = m->file.get_section(section_type::ranges);
+        } catch (format_error &e) {
+        }
+        if (root.has(DW_AT::GNU_ranges_base))
+                split->ranges_base = root[DW_AT::GNU_ranges_base].as_sec_offset();
+        split->base_address = root.has(DW_AT::low_pc) ? at_low_pc(root) : 0;
+        split->lt = get_line_table();
+
+        const die &split_root = m->split.root();
+        if (!split_root.has(DW_AT::GNU_dwo_id) ||
+            split_root[DW_AT::GNU_dwo_id].as_uconstant() != dwo_id)
+                m->split = compilation_unit();
+}
+
 //////////////////////////////////////////////////////////////////
 // class type_unit
 //
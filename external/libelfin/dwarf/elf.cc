@@ -27,6 +27,9 @@ static const struct
         {".debug_ranges",   section_type::ranges},
         {".debug_str",      section_type::str},
         {".debug_types",    section_type::types},
+        {".debug_addr",     section_type::addr},
+        {".debug_str_offsets", section_type::str_offsets},
+        {".debug_cu_index", section_type::cu_index},
 };
 
 bool
@@ -394,6 +394,12 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         throw runtime_error(to_string(op) + " not implemented");
 
                 case DW_OP::lo_user...DW_OP::hi_user:
+                        // GNU split DWARF extensions
+                        if (op == DW_OP::GNU_addr_index ||
+                            op == DW_OP::GNU_const_index) {
+                                stack.push_back(cu->get_indexed_address(cur.uleb128()));
+                                break;
+                        }
                         // XXX We could let the context evaluate this,
                         // but it would need access to the cursor.
                         throw expr_error("unknown user op " + to_string(op));
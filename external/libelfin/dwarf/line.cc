@@ -158,7 +158,10 @@ line_table::end() const
 {
         if (!valid())
                 return iterator(nullptr, 0);
-        return iterator(this, m->sec->size());
+        // One past the end of the section.  The last row of the table
+        // leaves its iterator at the end of the section, so that
+        // can't be used to mark the end.
+        return iterator(this, m->sec->size() + 1);
 }
 
 line_table::iterator
@@ -271,6 +274,12 @@ line_table::iterator::iterator(const line_table *table, section_offset pos)
 line_table::iterator &
 line_table::iterator::operator++()
 {
+        if (pos >= table->m->sec->size()) {
+                // Past the last row; become the end iterator
+                pos = table->m->sec->size() + 1;
+                return *this;
+        }
+
         cursor cur(table->m->sec, pos);
 
         // Execute opcodes until we reach the end of the stream or an
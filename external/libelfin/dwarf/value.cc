@@ -26,11 +26,15 @@ value::get_section_offset() const
 taddr
 value::as_address() const
 {
-        if (form != DW_FORM::addr)
-                throw value_type_mismatch("cannot read " + to_string(typ) + " as address");
-
         cursor cur(cu->data(), offset);
-        return cur.address();
+        switch (form) {
+        case DW_FORM::addr:
+                return cur.address();
+        case DW_FORM::GNU_addr_index:
+                return cu->get_indexed_address(cur.uleb128());
+        default:
+                throw value_type_mismatch("cannot read " + to_string(typ) + " as address");
+        }
 }
 
 const void *
@@ -145,17 +149,7 @@ value::as_flag() const
 rangelist
 value::as_rangelist() const
 {
-        section_offset off = as_sec_offset();
-
-        // The compilation unit may not have a base address.  In this
-        // case, the first entry in the range list must be a base
-        // address entry, but we'll just assume 0 for the initial base
-        // address.
-        die cudie = cu->root();
-        taddr cu_low_pc = cudie.has(DW_AT::low_pc) ? at_low_pc(cudie) : 0;
-        auto sec = cu->get_dwarf().get_section(section_type::ranges);
-        auto cusec = cu->data();
-        return rangelist(sec, off, cusec->addr_size, cu_low_pc);
+        return cu->get_rangelist(as_sec_offset());
 }
 
 die
@@ -245,6 +239,8 @@ value::as_cstr(size_t *size_out) const
                 cursor scur(cu->get_dwarf().get_section(section_type::str), off);
                 return scur.cstr(size_out);
         }
+        case DW_FORM::GNU_str_index:
+                return cu->get_indexed_str(cur.uleb128(), size_out);
         default:
                 throw value_type_mismatch("cannot read " + to_string(typ) + " as string");
         }
@@ -225,6 +225,7 @@ enum class shf : Elf64::Xword
         write     = 0x1,        // Section contains writable data
         alloc     = 0x2,        // Section is allocated in memory image of program
         execinstr = 0x4,        // Section contains executable instructions
+        compressed = 0x800,     // Section data is compressed (see Chdr)
         maskos    = 0x0F000000, // Environment-specific use
         maskproc  = 0xF0000000, // Processor-specific use
 };
@@ -309,6 +310,64 @@ struct Shdr
         }
 };
 
+// Compression algorithms of compressed sections (gABI ch_type)
+enum class elfcompress : ElfTypes::Word
+{
+        zlib   = 1,             // ZLIB/DEFLATE stream
+        zstd   = 2,             // Zstandard frame
+        loos   = 0x60000000,    // Environment-specific use
+        hios   = 0x6FFFFFFF,
+        loproc = 0x70000000,    // Processor-specific use
+        hiproc = 0x7FFFFFFF,
+};
+
+std::string
+to_string(elfcompress v);
+
+// Compression header, found at the start of the data of sections
+// with shf::compressed set (gABI "Section Compression")
+template<typename E = Elf64, byte_order Order = byte_order::native>
+struct Chdr;
+
+template<byte_order Order>
+struct Chdr<Elf32, Order>
+{
+        typedef Elf32 types;
+        static const byte_order order = Order;
+
+        elfcompress type;       // Compression algorithm
+        Elf32::Word size;       // Uncompressed size of section
+        Elf32::Word addralign;  // Uncompressed alignment of section
+
+        template<typename E2>
+        void from(const E2 &o)
+        {
+                type      = swizzle(o.type, o.order, order);
+                size      = swizzle(o.size, o.order, order);
+                addralign = swizzle(o.addralign, o.order, order);
+        }
+};
+
+template<byte_order Order>
+struct Chdr<Elf64, Order>
+{
+        typedef Elf64 types;
+        static const byte_order order = Order;
+
+        elfcompress  type;      // Compression algorithm
+        Elf64::Word  reserved;
+        Elf64::Xword size;      // Uncompressed size of section
+        Elf64::Xword addralign; // Uncompressed alignment of section
+
+        template<typename E2>
+        void from(const E2 &o)
+        {
+                type      = swizzle(o.type, o.order, order);
+                size      = swizzle(o.size, o.order, order);
+                addralign = swizzle(o.addralign, o.order, order);
+        }
+};
+
 // Segment types (ELF64 table 16)
 enum class pt : ElfTypes::Word
 {
@@ -11,6 +11,7 @@
 #include <cstddef>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 ELFPP_BEGIN_NAMESPACE
@@ -70,6 +71,16 @@ public:
 
         elf& operator=(const elf &o) = default;
 
+        bool operator==(const elf &o) const
+        {
+                return m == o.m;
+        }
+
+        bool operator!=(const elf &o) const
+        {
+                return m != o.m;
+        }
+
         bool valid() const
         {
                 return !!m;
@@ -114,11 +125,45 @@ public:
          */
         const section &get_section(unsigned index) const;
 
+        /**
+         * Return the GNU build ID of this file as a lower-case hex
+         * string, or an empty string if the file has no build ID
+         * note.
+         */
+        std::string get_build_id() const;
+
+        /**
+         * Return the file name recorded in this file's
+         * .gnu_debuglink section, or an empty string if there is
+         * none.
+         */
+        std::string get_debuglink() const;
+
+        /**
+         * Set *crc_out to the CRC32 of the debug file recorded in
+         * this file's .gnu_debuglink section.  Returns false if there
+         * is no .gnu_debuglink or it is truncated.
+         */
+        bool get_debuglink_crc(std::uint32_t *crc_out) const;
+
 private:
         struct impl;
         std::shared_ptr<impl> m;
 };
 
+/**
+ * Locate the separate debug info file of f, which was loaded from
+ * path, the way GDB does: first by build ID under
+ * debug_dir/.build-id/, then by .gnu_debuglink next to path, in
+ * .debug/ next to path, and under debug_dir mirroring path's
+ * directory.  A candidate whose build ID does not match f's, or a
+ * .gnu_debuglink candidate whose CRC32 does not match the one
+ * recorded in f, is ignored.  Returns the path of the debug file, or an empty string if
+ * none is found.
+ */
+std::string find_debug_file(const elf &f, const std::string &path,
+                            const std::string &debug_dir = "/usr/lib/debug");
+
 /**
  * An interface for loading sections of an ELF file.
  */
@@ -260,14 +305,25 @@ public:
 
         /**
          * Return this section's data.  If this is a NOBITS section,
-         * return nullptr.
+         * return nullptr.  If this is a compressed section
+         * (shf::compressed), the data is decompressed on the first
+         * call and the returned buffer is kept live by this section.
+         * Throws format_error if the section uses an unsupported
+         * compression algorithm.
          */
         const void *data() const;
         /**
-         * Return the size of this section in bytes.
+         * Return the size of this section in bytes.  For compressed
+         * sections, this is the uncompressed size.
          */
         size_t size() const;
 
+        /**
+         * Return true if this section's data is compressed in the
+         * file.
+         */
+        bool is_compressed() const;
+
         /**
          * Return this section as a strtab.  Throws
          * section_type_mismatch if this section is not a string
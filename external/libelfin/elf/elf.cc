@@ -4,8 +4,17 @@
 
 #include "elf++.hh"
 
+#include <climits>
+#include <cstdlib>
 #include <cstring>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef ELFPP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 using namespace std;
 
 ELFPP_BEGIN_NAMESPACE
@@ -161,6 +170,163 @@ elf::get_segment(unsigned index) const
         return segments().at(index);
 }
 
+std::string
+elf::get_build_id() const
+{
+        // Build IDs are stored in an NT_GNU_BUILD_ID note, which is
+        // conventionally in .note.gnu.build-id, but could be in any
+        // note section.
+        static const Elf64::Word nt_gnu_build_id = 3;
+        byte_order ord = get_hdr().ei_data == elfdata::lsb ?
+                byte_order::lsb : byte_order::msb;
+
+        for (auto &sec : sections()) {
+                if (sec.get_hdr().type != sht::note)
+                        continue;
+                const char *pos = (const char*)sec.data();
+                const char *end = pos + sec.size();
+                while (pos + 3 * sizeof(Elf64::Word) <= end) {
+                        // Note header (ELF32 figure 2-3); the same
+                        // layout is used by ELF64
+                        const Elf64::Word *nhdr = (const Elf64::Word*)pos;
+                        Elf64::Word namesz = swizzle(nhdr[0], ord, byte_order::native);
+                        Elf64::Word descsz = swizzle(nhdr[1], ord, byte_order::native);
+                        Elf64::Word type = swizzle(nhdr[2], ord, byte_order::native);
+                        const char *name = pos + 3 * sizeof(Elf64::Word);
+                        const char *desc = name + ((namesz + 3) & ~3);
+                        pos = desc + ((descsz + 3) & ~3);
+                        if (pos > end)
+                                break;
+                        if (type != nt_gnu_build_id || namesz != 4 ||
+                            memcmp(name, "GNU", 4) != 0)
+                                continue;
+
+                        static const char hex[] = "0123456789abcdef";
+                        std::string res;
+                        for (Elf64::Word i = 0; i < descsz; i++) {
+                                unsigned char c = desc[i];
+                                res.push_back(hex[c >> 4]);
+                                res.push_back(hex[c & 0xf]);
+                        }
+                        return res;
+                }
+        }
+        return "";
+}
+
+std::string
+elf::get_debuglink() const
+{
+        // .gnu_debuglink holds a NUL-terminated file name, padding,
+        // and a CRC32 of the debug file
+        auto &sec = get_section(".gnu_debuglink");
+        if (!sec.valid() || !sec.size())
+                return "";
+        const char *name = (const char*)sec.data();
+        return std::string(name, strnlen(name, sec.size()));
+}
+
+bool
+elf::get_debuglink_crc(std::uint32_t *crc_out) const
+{
+        // The CRC follows the name and its padding to a 4-byte
+        // boundary, in the file's byte order
+        auto &sec = get_section(".gnu_debuglink");
+        if (!sec.valid())
+                return false;
+        const char *name = (const char*)sec.data();
+        size_t pos = (strnlen(name, sec.size()) + 1 + 3) & ~(size_t)3;
+        if (pos + sizeof(std::uint32_t) > sec.size())
+                return false;
+        std::uint32_t crc;
+        memcpy(&crc, name + pos, sizeof crc);
+        byte_order ord = get_hdr().ei_data == elfdata::lsb ?
+                byte_order::lsb : byte_order::msb;
+        *crc_out = swizzle(crc, ord, byte_order::native);
+        return true;
+}
+
+/**
+ * Compute the CRC32 of the whole file open at fd, the way
+ * .gnu_debuglink records it.
+ */
+static bool
+file_crc32(int fd, std::uint32_t *crc_out)
+{
+        uLong crc = crc32(0, Z_NULL, 0);
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof buf)) > 0)
+                crc = crc32(crc, (const Bytef*)buf, n);
+        if (n < 0)
+                return false;
+        *crc_out = crc;
+        return true;
+}
+
+std::string
+find_debug_file(const elf &f, const std::string &path,
+                const std::string &debug_dir)
+{
+        std::string build_id = f.get_build_id();
+        std::uint32_t link_crc;
+        bool have_link_crc = f.get_debuglink_crc(&link_crc);
+
+        auto try_file = [&](const std::string &candidate, bool check_crc) {
+                if (candidate == path)
+                        return false;
+                int fd = open(candidate.c_str(), O_RDONLY);
+                if (fd < 0)
+                        return false;
+                // A stale or unrelated file with the linked name
+                // must not be picked up, GDB checks the CRC too
+                std::uint32_t crc;
+                if (check_crc && have_link_crc &&
+                    (!file_crc32(fd, &crc) || crc != link_crc)) {
+                        close(fd);
+                        return false;
+                }
+                try {
+                        elf df(create_mmap_loader(fd));
+                        return build_id.empty() ||
+                                df.get_build_id() == build_id;
+                } catch (std::exception &e) {
+                        return false;
+                }
+        };
+
+        if (build_id.size() > 2) {
+                std::string candidate = debug_dir + "/.build-id/" +
+                        build_id.substr(0, 2) + "/" + build_id.substr(2) +
+                        ".debug";
+                if (try_file(candidate, false))
+                        return candidate;
+        }
+
+        std::string link = f.get_debuglink();
+        if (link.empty())
+                return "";
+
+        std::string dir;
+        char *real = realpath(path.c_str(), nullptr);
+        if (real) {
+                dir = real;
+                free(real);
+        } else {
+                dir = path;
+        }
+        size_t slash = dir.rfind('/');
+        dir = slash == std::string::npos ? "." : dir.substr(0, slash);
+
+        for (auto &candidate : {dir + "/" + link,
+                                dir + "/.debug/" + link,
+                                debug_dir + dir + "/" + link}) {
+                if (try_file(candidate, true))
+                        return candidate;
+        }
+        return "";
+}
+
 //////////////////////////////////////////////////////////////////
 // class segment
 //
@@ -223,14 +389,136 @@ enums::to_string(shn v)
 struct section::impl
 {
         impl(const elf &f)
-                : f(f), name(nullptr), data(nullptr) { }
+                : f(f), name(nullptr), data(nullptr), have_chdr(false) { }
 
         const elf f;
         Shdr<> hdr;
         const char *name;
         size_t name_len;
         const void *data;
+
+        // Compressed sections only
+        bool have_chdr;
+        Chdr<> chdr;
+        std::unique_ptr<char[]> buf;
+
+        const Chdr<> &get_chdr();
+        const void *decompress();
+};
+
+const Chdr<> &
+section::impl::get_chdr()
+{
+        if (!have_chdr) {
+                auto &ehdr = f.get_hdr();
+                size_t chdr_size = (ehdr.ei_class == elfclass::_32 ?
+                                    sizeof(Chdr<Elf32>) : sizeof(Chdr<Elf64>));
+                if (hdr.size < chdr_size)
+                        throw format_error("compressed section too small");
+                canon_hdr(&chdr, f.get_loader()->load(hdr.offset, chdr_size),
+                          ehdr.ei_class, ehdr.ei_data);
+                have_chdr = true;
+        }
+        return chdr;
+}
+
+/**
+ * A zlib inflate stream that is reset rather than set up again for
+ * each section.  There is one per thread.
+ */
+struct inflater
+{
+        z_stream zs;
+        bool ok;
+
+        inflater()
+        {
+                memset(&zs, 0, sizeof(zs));
+                ok = inflateInit(&zs) == Z_OK;
+        }
+
+        ~inflater()
+        {
+                if (ok)
+                        inflateEnd(&zs);
+        }
+
+        bool inflate_all(const char *in, size_t in_size, char *out, size_t out_size)
+        {
+                if (!ok || inflateReset(&zs) != Z_OK)
+                        return false;
+                // avail_in and avail_out are 32 bits wide
+                zs.next_in = (Bytef*)in;
+                zs.next_out = (Bytef*)out;
+                zs.avail_in = zs.avail_out = 0;
+                int ret;
+                do {
+                        if (zs.avail_in == 0) {
+                                zs.avail_in = min(in_size, (size_t)UINT_MAX);
+                                in_size -= zs.avail_in;
+                        }
+                        if (zs.avail_out == 0) {
+                                zs.avail_out = min(out_size, (size_t)UINT_MAX);
+                                out_size -= zs.avail_out;
+                        }
+                        ret = inflate(&zs, Z_NO_FLUSH);
+                } while (ret == Z_OK);
+                return ret == Z_STREAM_END && zs.avail_out == 0 && out_size == 0;
+        }
+};
+
+#ifdef ELFPP_HAVE_ZSTD
+/**
+ * A zstd decompression context, likewise reused by each thread.
+ */
+struct zstd_context
+{
+        ZSTD_DCtx *dctx;
+
+        zstd_context() : dctx(ZSTD_createDCtx()) { }
+        ~zstd_context() { ZSTD_freeDCtx(dctx); }
 };
+#endif
+
+const void *
+section::impl::decompress()
+{
+        // The compressed stream follows the compression header
+        auto &ehdr = f.get_hdr();
+        size_t chdr_size = (ehdr.ei_class == elfclass::_32 ?
+                            sizeof(Chdr<Elf32>) : sizeof(Chdr<Elf64>));
+        const Chdr<> &ch = get_chdr();
+        const char *in = (const char*)f.get_loader()->load(hdr.offset, hdr.size)
+                + chdr_size;
+        size_t in_size = hdr.size - chdr_size;
+
+        std::unique_ptr<char[]> out(new char[ch.size]);
+        switch (ch.type) {
+        case elfcompress::zlib: {
+                static thread_local inflater zlib;
+                if (!zlib.inflate_all(in, in_size, out.get(), ch.size))
+                        throw format_error("corrupt zlib-compressed section");
+                break;
+        }
+#ifdef ELFPP_HAVE_ZSTD
+        case elfcompress::zstd: {
+                static thread_local zstd_context zstd;
+                if (!zstd.dctx)
+                        throw bad_alloc();
+                size_t out_size = ZSTD_decompressDCtx(zstd.dctx, out.get(),
+                                                      ch.size, in, in_size);
+                if (ZSTD_isError(out_size) || out_size != ch.size)
+                        throw format_error("corrupt zstd-compressed section");
+                break;
+        }
+#endif
+        default:
+                throw format_error("unsupported section compression " +
+                                   to_string(ch.type));
+        }
+        buf = std::move(out);
+        return buf.get();
+}
 
 section::section(const elf &f, const void *hdr)
         : m(make_shared<impl>(f))
@@ -267,17 +555,30 @@ section::data() const
 {
         if (m->hdr.type == sht::nobits)
                 return nullptr;
-        if (!m->data)
-                m->data = m->f.get_loader()->load(m->hdr.offset, m->hdr.size);
+        if (!m->data) {
+                if (is_compressed())
+                        m->data = m->decompress();
+                else
+                        m->data = m->f.get_loader()->load(m->hdr.offset, m->hdr.size);
+        }
         return m->data;
 }
 
 size_t
 section::size() const
 {
+        if (is_compressed())
+                return m->get_chdr().size;
         return m->hdr.size;
 }
 
+bool
+section::is_compressed() const
+{
+        return (m->hdr.flags & shf::compressed) == shf::compressed &&
+                m->hdr.type != sht::nobits;
+}
+
 strtab
 section::as_strtab() const
 {
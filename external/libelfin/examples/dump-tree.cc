@@ -1,12 +1,33 @@
 #include "elf++.hh"
 #include "dwarf++.hh"
 
+#include <chrono>
+#include <cstdlib>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <new>
 
 using namespace std;
 
+// Heap allocation counter for --stats
+static size_t n_allocs;
+
+void *
+operator new(size_t size)
+{
+        n_allocs++;
+        if (void *p = malloc(size ? size : 1))
+                return p;
+        throw bad_alloc();
+}
+
+void
+operator delete(void *p) noexcept
+{
+        free(p);
+}
+
 void
 dump_tree(const dwarf::die &node, int depth = 0)
 {
@@ -21,23 +42,100 @@ dump_tree(const dwarf::die &node, int depth = 0)
                 dump_tree(child, depth + 1);
 }
 
+// Visit every DIE below node through die::iterator, reading each
+// name the way a by-name lookup would.
+size_t
+scan_tree(const dwarf::die &node, size_t *name_bytes)
+{
+        size_t n = 1;
+        if (node.has(dwarf::DW_AT::name))
+                *name_bytes += at_name(node).size();
+        for (auto &child : node)
+                n += scan_tree(child, name_bytes);
+        return n;
+}
+
+// Visit every DIE in a unit through its die_table.
+size_t
+scan_table(const dwarf::die_table &t, size_t *name_bytes)
+{
+        for (dwarf::die_table::index i = 0; i < t.size(); i++) {
+                size_t len;
+                if (t.get_cstr(i, dwarf::DW_AT::name, &len))
+                        *name_bytes += len;
+        }
+        return t.size();
+}
+
+template<typename Scan>
+void
+report(const char *what, Scan scan)
+{
+        // Take the best of a few runs to filter out noise
+        double best = 0;
+        size_t dies = 0, allocs = 0, name_bytes = 0;
+        for (int run = 0; run < 5; run++) {
+                size_t start_allocs = n_allocs;
+                auto start = chrono::steady_clock::now();
+                dies = scan(&name_bytes);
+                chrono::duration<double> secs =
+                        chrono::steady_clock::now() - start;
+                allocs = n_allocs - start_allocs;
+                if (run == 0 || secs.count() < best)
+                        best = secs.count();
+        }
+        printf("%-10s %10zu DIEs %10.3f ms %12.0f DIEs/s %10zu allocs/scan\n",
+               what, dies, best * 1e3, dies / best, allocs);
+}
+
+void
+stats(const dwarf::dwarf &dw)
+{
+        report("iterator", [&](size_t *name_bytes) {
+                        size_t n = 0;
+                        for (auto &cu : dw.compilation_units())
+                                n += scan_tree(cu.root(), name_bytes);
+                        return n;
+                });
+
+        auto start = chrono::steady_clock::now();
+        for (auto &cu : dw.compilation_units())
+                cu.get_die_table();
+        chrono::duration<double> build = chrono::steady_clock::now() - start;
+        printf("%-10s %10.3f ms\n", "build", build.count() * 1e3);
+
+        report("die_table", [&](size_t *name_bytes) {
+                        size_t n = 0;
+                        for (auto &cu : dw.compilation_units())
+                                n += scan_table(cu.get_die_table(), name_bytes);
+                        return n;
+                });
+}
+
 int
 main(int argc, char **argv)
 {
-        if (argc != 2) {
-                fprintf(stderr, "usage: %s elf-file\n", argv[0]);
+        bool do_stats = argc == 3 && strcmp(argv[1], "--stats") == 0;
+        if (argc != 2 && !do_stats) {
+                fprintf(stderr, "usage: %s [--stats] elf-file\n", argv[0]);
                 return 2;
         }
+        const char *path = argv[argc - 1];
 
-        int fd = open(argv[1], O_RDONLY);
+        int fd = open(path, O_RDONLY);
         if (fd < 0) {
-                fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+                fprintf(stderr, "%s: %s\n", path, strerror(errno));
                 return 1;
         }
 
         elf::elf ef(elf::create_mmap_loader(fd));
         dwarf::dwarf dw(dwarf::elf::create_loader(ef));
 
+        if (do_stats) {
+                stats(dw);
+                return 0;
+        }
+
         for (auto cu : dw.compilation_units()) {
                 printf("--- <%" PRIx64 ">\n", cu.get_section_offset());
                 dump_tree(cu.root());
@@ -16,6 +16,7 @@ public:
 
     [[nodiscard]] auto is_enabled() const -> bool;
     [[nodiscard]] auto get_address() const -> std::intptr_t;
+    [[nodiscard]] auto get_saved_data() const -> uint8_t;
 
 private:
     pid_t m_pid;
@@ -1,12 +1,17 @@
 #ifndef DEBUGGER_DEBUGGER_H
 
+#include <iostream>
 #include <string>
 #include "../external/libelfin/dwarf/dwarf++.hh"
 #include "../external/libelfin/elf/elf++.hh"
 #include <vector>
+#include <set>
 #include <unordered_map>
 #include <bits/types/siginfo_t.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
 #include "breakpoint.h"
+#include "event_loop.h"
 
 #define DEBUGGER_DEBUGGER_H
 
@@ -27,17 +32,57 @@ struct symbol {
 
 class debugger {
 public:
-    debugger(std::string prog_name, pid_t pid) : m_prog_name{std::move(prog_name)}, m_pid{pid} {
+    debugger(std::string prog_name, pid_t pid) : m_prog_name{std::move(prog_name)}, m_pid{pid}, m_events{pid} {
         auto fd = open(m_prog_name.c_str(), O_RDONLY);
 
         m_elf = elf::elf{elf::create_mmap_loader(fd)};
-        m_dwarf = dwarf::dwarf{dwarf::elf::create_loader(m_elf)};
+        m_debug_elf = m_elf;
+
+        // stripped binaries keep their DWARF in a separate file, found via build-id or .gnu_debuglink
+        if (!m_elf.get_section(".debug_info").valid()) {
+            auto debug_file = elf::find_debug_file(m_elf, m_prog_name);
+            int debug_fd = debug_file.empty() ? -1 : open(debug_file.c_str(), O_RDONLY);
+            if (debug_fd != -1) {
+                m_debug_elf = elf::elf{elf::create_mmap_loader(debug_fd)};
+            }
+        }
+
+        // compressed sections are decompressed on first use
+        m_dwarf = dwarf::dwarf{dwarf::elf::create_loader(m_debug_elf)};
+
+        // with split DWARF the DIEs are in the .dwo files the units name, or all in a package next to the program
+        auto open_dwo = [](const std::string &path) -> std::shared_ptr<dwarf::loader> {
+            int dwo_fd = open(path.c_str(), O_RDONLY);
+            if (dwo_fd == -1) {
+                return nullptr;
+            }
+            return dwarf::elf::create_loader(elf::elf{elf::create_mmap_loader(dwo_fd)});
+        };
+        int dwp_fd = open((m_prog_name + ".dwp").c_str(), O_RDONLY);
+        try {
+            std::shared_ptr<dwarf::loader> package;
+            if (dwp_fd != -1) {
+                package = dwarf::elf::create_loader(elf::elf{elf::create_mmap_loader(dwp_fd)});
+            }
+            m_dwarf.set_split_dwarf(package, open_dwo);
+        } catch (std::runtime_error &e) {
+            std::cerr << "Ignoring " << m_prog_name << ".dwp: " << e.what() << std::endl;
+            m_dwarf.set_split_dwarf(nullptr, open_dwo);
+        }
     };
 
     siginfo_t get_signal_info();
 
     void handle_command(const std::string &line);
 
+    void handle_stats_command(const std::vector<std::string> &args);
+
+    void handle_catch_command(const std::vector<std::string> &args);
+
+    void handle_trace_syscalls_command(const std::vector<std::string> &args);
+
+    void handle_find_command(const std::vector<std::string> &args, bool all);
+
     void handle_sigtrap(siginfo_t info);
 
     std::vector<std::string> split(const std::string &s, char delimiter);
@@ -66,7 +111,23 @@ public:
 
     void single_step_instruction_with_breakpoint_check();
 
-    void wait_for_signal();
+    int wait_for_signal();
+
+    void handle_interrupt();
+
+    // syscalls the seccomp filter of the program hands to the debugger, see install_syscall_filter
+    void set_filtered_syscalls(const std::vector<long> &numbers);
+
+    [[nodiscard]] auto has_syscall_filter() const -> bool;
+
+    // returns true if the program should stay stopped at the syscall
+    bool handle_syscall_entry();
+
+    void handle_syscall_exit();
+
+    [[nodiscard]] auto get_last_wait_status() const -> int;
+
+    event_loop &get_event_loop();
 
     void dump_registers();
 
@@ -80,19 +141,43 @@ public:
 
     void write_memory(uint64_t address, uint64_t value);
 
+    // bulk access to the inferior's memory as the program sees it, i.e. without the int3s of the breakpoints,
+    // returns the number of bytes transferred
+    std::size_t read_memory(uint64_t address, void *buffer, std::size_t size);
+
+    std::size_t write_memory(uint64_t address, const void *buffer, std::size_t size);
+
+    // registers of the stopped inferior, read once per stop
+    const user_regs_struct &get_registers();
+
+    void set_registers(const user_regs_struct &regs);
+
     uint64_t get_pc();
 
     void set_pc(uint64_t pc);
 
     void run();
 
+    // continues until the next stop and returns its wait status, delivering signal to the inferior
+    int continue_execution(int signal = 0);
+
 private:
     std::string m_prog_name;
     pid_t m_pid;
+    event_loop m_events;
     dwarf::dwarf m_dwarf;
     elf::elf m_elf;
-
-    void continue_execution();
+    elf::elf m_debug_elf; // file the DWARF is read from, same as m_elf unless the debug info is separate
+    user_regs_struct m_registers{};
+    bool m_registers_valid = false;
+    int m_last_wait_status = 0;
+    std::set<long> m_filtered_syscalls;
+    std::set<long> m_caught_syscalls;
+    bool m_trace_syscalls = false;
+    std::string m_syscall_in_flight; // traced call waiting for its exit stop to print the result
+    bool m_resume_after_stop = false; // the last stop was a filtered syscall nobody asked to stop at
+
+    void resume(__ptrace_request request, int signal = 0);
 
     std::unordered_map<std::intptr_t, breakpoint> m_breakpoints;
 };
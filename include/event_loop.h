@@ -0,0 +1,89 @@
+#ifndef DEBUGGER_EVENT_LOOP_H
+#define DEBUGGER_EVENT_LOOP_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+#include <vector>
+
+// waits for the inferior, the prompt and signals on one epoll instance, so the prompt stays live while
+// the inferior runs. Everything runs on the thread owning the loop, which has to be the tracer, except
+// linenoise, which blocks in a thread of its own and hands the lines over
+class event_loop {
+public:
+    explicit event_loop(pid_t pid);
+
+    ~event_loop();
+
+    event_loop(const event_loop &) = delete;
+
+    event_loop &operator=(const event_loop &) = delete;
+
+    // starts reading commands from the terminal, until then wait_for_stop only waits for the inferior
+    void enable_input(std::string prompt);
+
+    // the next line typed at the prompt, nothing once input is closed. Runs the idle tasks while waiting
+    std::optional<std::string> read_line();
+
+    // waits until the inferior stops or exits and returns its wait status. Meanwhile `interrupt` and
+    // Ctrl-C interrupt it, any other line is kept for read_line
+    int wait_for_stop();
+
+    // stops the running inferior, with PTRACE_INTERRUPT if it was seized and SIGSTOP otherwise
+    void interrupt();
+
+    // work for the time spent waiting, called until it returns false
+    void add_idle_task(std::function<bool()> task);
+
+    // calls on_readable whenever fd has something to read while waiting, e.g. a remote client's socket
+    void watch(int fd, std::function<void()> on_readable);
+
+    void unwatch(int fd);
+
+    [[nodiscard]] auto has_exited() const -> bool;
+
+private:
+    struct input;
+
+    void wait_once(int timeout_ms);
+
+    void request_line();
+
+    void take_input();
+
+    void take_signals();
+
+    void handle_line(std::string line);
+
+    auto run_idle_task() -> bool;
+
+    void add_new_tracee(pid_t parent);
+
+    // the children and threads of a program with a syscall filter are traced along with it, since the filter makes
+    // their syscalls fail without a tracer. They aren't debugged, this only keeps them running
+    void resume_other_tracee(pid_t pid, int wait_status);
+
+    // resumes the other tracees that stopped while the inferior is stopped too
+    void reap_other_tracees();
+
+    pid_t m_pid;
+    int m_epoll_fd;
+    int m_signal_fd;
+    int m_pid_fd = -1; // -1 without pidfd_open, SIGCHLD reports the exit as well then
+    bool m_running = false;
+    bool m_exited = false;
+    int m_exit_status = 0;
+    bool m_line_requested = false;
+    std::deque<std::string> m_lines; // typed but not handled yet
+    std::vector<std::function<bool()>> m_idle_tasks;
+    std::unordered_map<int, std::function<void()>> m_watched;
+    std::shared_ptr<input> m_input; // shared with the reader thread, which may outlive the loop
+    std::set<pid_t> m_other_tracees;
+};
+
+#endif //DEBUGGER_EVENT_LOOP_H
@@ -0,0 +1,109 @@
+#ifndef DEBUGGER_GDB_SERVER_H
+#define DEBUGGER_GDB_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+class debugger;
+
+// serves the GDB remote serial protocol on a local socket, so GDB, IDEs and scripts can drive the debugger.
+// Packets are parsed in place in the receive buffer and replies are encoded in place in the send buffer,
+// both buffers are allocated once for the largest packet
+class gdb_server {
+public:
+    // largest packet in either direction, announced in qSupported
+    static constexpr std::size_t packet_size = 0x40000;
+
+    gdb_server(debugger &dbg, pid_t pid);
+
+    ~gdb_server();
+
+    gdb_server(const gdb_server &) = delete;
+
+    gdb_server &operator=(const gdb_server &) = delete;
+
+    // listens on a TCP port of localhost if address is a number, on a unix socket at that path otherwise,
+    // and waits for a client to connect
+    void accept_client(const std::string &address);
+
+    // serves the client until it detaches, kills the program or goes away
+    void run();
+
+private:
+    bool receive();
+
+    auto process_input() -> bool;
+
+    void handle_packet(char *data, std::size_t size);
+
+    void handle_query(std::string_view packet);
+
+    void handle_xfer(std::string_view object, std::string_view annex_and_range);
+
+    void handle_vcont(std::string_view actions);
+
+    void resume(bool step, int signal);
+
+    void read_registers();
+
+    void write_registers(std::string_view hex);
+
+    void read_register(std::string_view packet);
+
+    void write_register(std::string_view packet);
+
+    void read_memory_hex(std::string_view packet);
+
+    void write_memory_hex(std::string_view packet);
+
+    void read_memory_binary(std::string_view packet);
+
+    void write_memory_binary(char *data, std::size_t size);
+
+    void set_breakpoint(std::string_view packet, bool insert);
+
+    void stop_reply();
+
+    std::string threads_xml() const;
+
+    std::string libraries_xml() const;
+
+    // reply encoding, straight into m_out
+    void begin_reply();
+
+    void append(std::string_view text);
+
+    void append_hex(const void *data, std::size_t size);
+
+    void append_hex_number(std::uint64_t value);
+
+    void append_binary(const void *data, std::size_t size);
+
+    void send_reply();
+
+    void send_raw(const char *data, std::size_t size);
+
+    debugger &m_dbg;
+    pid_t m_pid;
+    int m_listen_fd = -1;
+    int m_client_fd = -1;
+    std::string m_socket_path; // unlinked when the server goes away, empty for TCP
+    bool m_no_ack = false;
+    bool m_done = false;
+    bool m_running = false;
+    int m_last_status;
+    std::set<std::uintptr_t> m_breakpoints; // set by the client
+
+    std::vector<char> m_in;
+    std::size_t m_in_begin = 0; // first byte not processed yet
+    std::size_t m_in_end = 0;
+    std::vector<char> m_out;
+    std::size_t m_out_size = 0;
+};
+
+#endif //DEBUGGER_GDB_SERVER_H
@@ -0,0 +1,22 @@
+#ifndef DEBUGGER_MEMORY_MAP_H
+#define DEBUGGER_MEMORY_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// a line of /proc/<pid>/maps
+struct memory_region {
+    std::uintptr_t start;
+    std::uintptr_t end;
+    bool readable;
+    bool writable;
+    bool executable;
+    std::uint64_t offset;
+    std::string path; // empty for anonymous memory, [heap], [stack] etc. for the kernel's pseudo paths
+};
+
+std::vector<memory_region> read_memory_map(pid_t pid);
+
+#endif //DEBUGGER_MEMORY_MAP_H
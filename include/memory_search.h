@@ -0,0 +1,35 @@
+#ifndef DEBUGGER_MEMORY_SEARCH_H
+#define DEBUGGER_MEMORY_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+struct search_range {
+    std::uintptr_t start;
+    std::uintptr_t end;
+};
+
+struct search_result {
+    std::vector<std::uintptr_t> matches; // the lowest addresses, at most max_matches of them
+    std::uint64_t count = 0; // all matches
+    std::uint64_t bytes_searched = 0;
+};
+
+// the bytes to look for from the pattern of the find commands: "strings" with \n, \t, \xHH escapes and integers,
+// little endian and as wide as the size letter says (b, h, w or g). Without a size letter integers take 4 bytes
+// if they fit and 8 otherwise, so pointers take 8. Throws std::invalid_argument for a malformed pattern
+std::vector<std::uint8_t> parse_search_pattern(const std::string &pattern, char size = 0);
+
+// searches the inferior's memory in the given ranges, which have to be mapped, readable and in ascending order. The
+// ranges are read in chunks with process_vm_readv and searched in parallel, every searcher gets its chunks from a
+// reader thread of its own that fills one buffer while the other is being searched. patches are bytes to search
+// instead of the ones in memory, i.e. the original instructions under the breakpoints
+search_result search_memory(pid_t pid, const std::vector<search_range> &ranges, const std::vector<std::uint8_t> &pattern,
+                            const std::vector<std::pair<std::uintptr_t, std::uint8_t>> &patches,
+                            std::size_t max_matches);
+
+#endif //DEBUGGER_MEMORY_SEARCH_H
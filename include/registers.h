@@ -11,6 +11,8 @@
 #include <cstddef>
 #include <string>
 
+#include "stats.h"
+
 #ifndef DEBUGGER_REGISTERS_H
 #define DEBUGGER_REGISTERS_H
 
@@ -84,27 +86,35 @@ const boost::array <reg_descriptor, n_registers>
                 {reg::gs, 55, "gs"},
         }};
 
-uint64_t get_register_value(pid_t pid, reg r) {
-    user_regs_struct regs{};
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+uint64_t get_register_value(const user_regs_struct &regs, reg r) {
     const reg_descriptor *it =
             std::find_if(std::begin(g_registers_descriptors),
                          std::end(g_registers_descriptors),
                          [r](auto &&rd) { return rd.r == r; });
-    return *(reinterpret_cast<uint64_t *>(&regs) +
+    return *(reinterpret_cast<const uint64_t *>(&regs) +
              (it - std::begin(g_registers_descriptors)));
 }
 
-void set_register_value(pid_t pid, reg r, uint64_t value) {
-    user_regs_struct regs{};
-    ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+void set_register_value(user_regs_struct &regs, reg r, uint64_t value) {
     const reg_descriptor *it =
             std::find_if(std::begin(g_registers_descriptors),
                          std::end(g_registers_descriptors),
                          [r](auto &&rd) { return rd.r == r; });
     *(reinterpret_cast<uint64_t *>(&regs) +
       (it - std::begin(g_registers_descriptors))) = value;
-    ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
+}
+
+uint64_t get_register_value(pid_t pid, reg r) {
+    user_regs_struct regs{};
+    stats::ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+    return get_register_value(regs, r);
+}
+
+void set_register_value(pid_t pid, reg r, uint64_t value) {
+    user_regs_struct regs{};
+    stats::ptrace(PTRACE_GETREGS, pid, nullptr, &regs);
+    set_register_value(regs, r, value);
+    stats::ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
 }
 
 
@@ -0,0 +1,176 @@
+#ifndef DEBUGGER_STATS_H
+#define DEBUGGER_STATS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+// instrumentation for the `stats` command: every syscall the debugger makes on the inferior goes through
+// the wrappers below, which count it per thread and time it into allocation-free histograms
+namespace stats {
+
+enum class syscall {
+    peekdata,
+    pokedata,
+    getregs,
+    setregs,
+    cont,
+    singlestep,
+    getsiginfo,
+    other_ptrace,
+    waitpid,
+    process_vm_readv,
+    process_vm_writev,
+};
+
+constexpr std::size_t n_syscalls = 11;
+
+// where the time of a command goes, every nanosecond is charged to exactly one of these
+enum class category {
+    other,  // the debugger's own logic
+    ptrace,
+    wait,   // waiting for the inferior to stop
+    dwarf,  // DWARF lookups
+    output, // formatting and printing
+};
+
+constexpr std::size_t n_categories = 5;
+
+std::string to_string(syscall s);
+
+std::string to_string(category c);
+
+// log-linear latency histogram in nanoseconds (HDR style): every power of two is split into 8 linear
+// sub-buckets, so any recorded value is off by at most 12.5%, and recording never allocates
+class histogram {
+public:
+    void record(std::uint64_t ns);
+
+    void merge(const histogram &other);
+
+    // the upper bound of the bucket holding the p-th percentile, p in [0, 100]
+    [[nodiscard]] auto percentile(double p) const -> std::uint64_t;
+
+    [[nodiscard]] auto count() const -> std::uint64_t { return m_count; }
+
+    [[nodiscard]] auto sum() const -> std::uint64_t { return m_sum; }
+
+    [[nodiscard]] auto max() const -> std::uint64_t { return m_max; }
+
+private:
+    static constexpr unsigned sub_bucket_bits = 3;
+    static constexpr std::size_t n_buckets = 64 << sub_bucket_bits;
+
+    static auto bucket_of(std::uint64_t ns) -> std::size_t;
+
+    static auto upper_bound_of(std::size_t bucket) -> std::uint64_t;
+
+    std::array<std::uint64_t, n_buckets> m_buckets{};
+    std::uint64_t m_count = 0;
+    std::uint64_t m_sum = 0;
+    std::uint64_t m_max = 0;
+};
+
+struct command_stats {
+    std::uint64_t runs = 0;
+    std::uint64_t syscalls = 0;
+    histogram latency;
+};
+
+// counters of one thread, only ever written by that thread
+struct thread_stats {
+    std::array<histogram, n_syscalls> syscalls;
+    std::array<std::uint64_t, n_categories> time_ns{};
+    histogram stop_to_prompt;
+    std::map<std::string, command_stats> commands; // only touched once per command
+
+    // bookkeeping of the running command and timer
+    category current = category::other;
+    std::uint64_t current_since = 0;
+    unsigned active = 0; // commands and timers in flight
+    std::uint64_t syscall_count = 0;
+    std::uint64_t last_stop_ns = 0;
+    std::uint64_t stop_count = 0;
+
+    void merge(const thread_stats &other);
+};
+
+auto now_ns() -> std::uint64_t;
+
+auto this_thread() -> thread_stats &;
+
+// sums the counters of all threads (plus the ones that have exited). Threads that are still running
+// may be updating their counters while this reads them, so take it while they are quiet
+auto snapshot() -> thread_stats;
+
+void reset();
+
+void report(std::ostream &out);
+
+void report_json(std::ostream &out);
+
+// charges the time until it goes out of scope to a category, nested timers take their time out of the
+// enclosing one
+class scoped_timer {
+public:
+    explicit scoped_timer(category c);
+
+    ~scoped_timer();
+
+    scoped_timer(const scoped_timer &) = delete;
+
+    scoped_timer &operator=(const scoped_timer &) = delete;
+
+private:
+    category m_previous;
+};
+
+// accounts a command typed at the prompt: its syscalls, its latency, and the stop-to-prompt latency if the
+// inferior stopped while it ran
+class command_scope {
+public:
+    explicit command_scope(std::string name);
+
+    ~command_scope();
+
+    command_scope(const command_scope &) = delete;
+
+    command_scope &operator=(const command_scope &) = delete;
+
+private:
+    std::string m_name;
+    std::uint64_t m_start;
+    std::uint64_t m_syscalls_at_start;
+    std::uint64_t m_stops_at_start;
+};
+
+void record_syscall(syscall s, std::uint64_t start_ns);
+
+auto to_syscall(__ptrace_request request) -> syscall;
+
+template<typename Addr, typename Data>
+long ptrace(__ptrace_request request, pid_t pid, Addr addr, Data data) {
+    scoped_timer timer{category::ptrace};
+    auto start = now_ns();
+    auto ret = ::ptrace(request, pid, addr, data);
+    record_syscall(to_syscall(request), start);
+    return ret;
+}
+
+pid_t waitpid(pid_t pid, int *status, int options);
+
+ssize_t process_vm_readv(pid_t pid, const iovec *local, unsigned long local_count,
+                         const iovec *remote, unsigned long remote_count, unsigned long flags);
+
+ssize_t process_vm_writev(pid_t pid, const iovec *local, unsigned long local_count,
+                          const iovec *remote, unsigned long remote_count, unsigned long flags);
+
+} // namespace stats
+
+#endif //DEBUGGER_STATS_H
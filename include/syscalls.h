@@ -0,0 +1,42 @@
+#ifndef DEBUGGER_SYSCALLS_H
+#define DEBUGGER_SYSCALLS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/user.h>
+#include <vector>
+
+// an x86-64 system call the debugger can trace and decode
+struct syscall_info {
+    const char *name;
+    long number;
+    // one character per argument: d signed, u unsigned, x hex, s string, f directory fd, o open flags, m mode,
+    // a socket address whose length is the next argument
+    const char *args;
+};
+
+const syscall_info *find_syscall(std::string_view name);
+
+const syscall_info *find_syscall(long number);
+
+// reads the inferior's memory, returns the number of bytes read
+using memory_reader = std::function<std::size_t(std::uint64_t address, void *buffer, std::size_t size)>;
+
+// the call the registers of a syscall entry stop describe, e.g. openat(AT_FDCWD, "/etc/hosts", O_RDONLY)
+std::string format_syscall(const user_regs_struct &regs, const memory_reader &read);
+
+// the result in rax at the syscall exit stop, e.g. 3 or -1 (No such file or directory)
+std::string format_syscall_result(const user_regs_struct &regs);
+
+// jeq's jump offsets are 8 bits, every syscall adds an instruction between the check and the RET_TRACE
+constexpr std::size_t max_filtered_syscalls = 250;
+
+// installs a seccomp filter on the calling process that hands the given syscalls to the tracer and lets all others
+// through untouched. The tracer has to set PTRACE_O_TRACESECCOMP first, otherwise the filtered syscalls fail
+// with ENOSYS. Fails with EINVAL for no or more than max_filtered_syscalls syscalls, otherwise errno says why
+bool install_syscall_filter(const std::vector<long> &numbers);
+
+#endif //DEBUGGER_SYSCALLS_H
@@ -1,5 +1,6 @@
 #include "../include/debugger.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <sys/ptrace.h>
@@ -7,7 +8,15 @@
 #include <registers.h>
 #include <iomanip>
 #include <fstream>
+#include <cstring>
+#include <cctype>
+#include <limits>
+#include <algorithm>
 #include "linenoise.h"
+#include "../include/stats.h"
+#include "../include/syscalls.h"
+#include "../include/memory_map.h"
+#include "../include/memory_search.h"
 
 std::string to_string(symbol_type st) {
     switch (st) {
@@ -43,22 +52,38 @@ symbol_type to_symbol_type(elf::stt sym) {
 
 
 void debugger::run() {
-    int wait_status;
-    auto options = 0;
-
-    waitpid(m_pid, &wait_status, options);
+    m_events.enable_input("minidbg> ");
+
+    // index the DWARF while waiting for input or for the inferior, so the first lookups don't pay for it. With split
+    // DWARF only the skeleton units are, a split unit is read when a lookup gets to its compilation unit
+    std::size_t next_unit = 0;
+    m_events.add_idle_task([this, next_unit]() mutable {
+        const auto &units = m_dwarf.compilation_units();
+        if (next_unit == units.size()) {
+            return false;
+        }
+        stats::scoped_timer timer{stats::category::dwarf};
+        const auto &cu = units[next_unit++];
+        cu.get_die_table();
+        try {
+            cu.get_line_table();
+        } catch (dwarf::format_error &) {
+            // no line table, nothing to index
+        }
+        return next_unit < units.size();
+    });
 
-    char *line = nullptr;
-    while ((line = linenoise("minidbg> ")) != nullptr) {
-        handle_command(line);
-        linenoiseHistoryAdd(line);
-        linenoiseFree(line);
+    while (auto line = m_events.read_line()) {
+        if (!line->empty()) {
+            handle_command(*line);
+        }
     }
 }
 
 void debugger::handle_command(const std::string &line) {
     auto args = split(line, ' ');
     auto command = args[0];
+    stats::command_scope scope{command};
 
     if (is_prefix(command, "cont")) {
         continue_execution();
@@ -78,15 +103,30 @@ void debugger::handle_command(const std::string &line) {
         step_over();
     } else if (is_prefix(command, "finish")) {
         step_out();
+    } else if (is_prefix(command, "interrupt")) {
+        // while the program runs the event loop takes care of it, see event_loop::handle_line
+        std::cerr << "The program is not running\n";
+    } else if (is_prefix(command, "stats")) {
+        handle_stats_command(args);
+    } else if (is_prefix(command, "catch")) {
+        handle_catch_command(args);
+    } else if (is_prefix(command, "trace-syscalls")) {
+        handle_trace_syscalls_command(args);
+    } else if (is_prefix(command, "find")) {
+        handle_find_command(args, false);
+    } else if (is_prefix(command, "find-all")) {
+        handle_find_command(args, true);
     } else if (is_prefix(command, "register")) {
         if (is_prefix(args[1], "dump")) {
             dump_registers();
         }
     } else if (is_prefix(args[1], "read")) {
-        std::cout << get_register_value(m_pid, get_register_from_name(args[2])) << std::endl;
+        std::cout << get_register_value(get_registers(), get_register_from_name(args[2])) << std::endl;
     } else if (is_prefix(args[1], "write")) {
         std::string val{args[3], 2}; //assume 0xVAL
-        set_register_value(m_pid, get_register_from_name(args[2]), std::stol(val, 0, 16));
+        auto regs = get_registers();
+        set_register_value(regs, get_register_from_name(args[2]), std::stol(val, 0, 16));
+        set_registers(regs);
     } else if (is_prefix(command, "memory")) {
         std::string addr{args[2], 2}; //assume 0xADDRESS
 
@@ -123,6 +163,224 @@ std::vector<std::string> debugger::split(const std::string &s, char delimiter) {
     return out;
 }
 
+// memory held by what has been read from each compilation unit, the largest first. Skeleton units of split DWARF
+// are named after their .dwo and count as not indexed until the split unit is read, which this doesn't do
+void report_dwarf_memory(const dwarf::dwarf &dw, std::ostream &out) {
+    struct unit_memory {
+        std::string name;
+        std::size_t bytes;
+        std::size_t dies;
+    };
+    std::vector<unit_memory> units;
+    std::size_t total = 0, indexed = 0;
+    for (const auto &cu : dw.compilation_units()) {
+        const auto *split = cu.peek_split_unit();
+        std::string name = "?";
+        if (split && split->root().has(dwarf::DW_AT::name)) {
+            name = at_name(split->root());
+        } else if (cu.root().has(dwarf::DW_AT::GNU_dwo_name)) {
+            name = cu.root()[dwarf::DW_AT::GNU_dwo_name].as_string();
+        }
+        units.push_back({std::move(name), cu.memory_size(), split ? cu.indexed_dies() : 0});
+        total += units.back().bytes;
+        indexed += units.back().dies != 0;
+    }
+    std::sort(units.begin(), units.end(), [](auto &a, auto &b) { return a.bytes > b.bytes; });
+
+    auto flags = out.flags();
+    out << std::dec << "DWARF memory by compilation unit, " << indexed << " of " << units.size() << " indexed:\n"
+        << std::setw(10) << "KiB" << std::setw(10) << "DIEs" << "  unit\n" << std::fixed << std::setprecision(1);
+    for (const auto &u : units) {
+        out << std::setw(10) << u.bytes / 1024.0 << std::setw(10) << u.dies << "  " << u.name << '\n';
+    }
+    out << std::setw(10) << total / 1024.0 << std::setw(10) << "" << "  total" << std::endl;
+    out.flags(flags);
+}
+
+// stats: human readable report, stats json [file]: the same as JSON, stats memory: DWARF memory per compilation
+// unit, stats reset: start over
+void debugger::handle_stats_command(const std::vector<std::string> &args) {
+    stats::scoped_timer timer{stats::category::output};
+    if (args.size() < 2) {
+        stats::report(std::cout);
+    } else if (is_prefix(args[1], "json")) {
+        if (args.size() < 3) {
+            stats::report_json(std::cout);
+        } else {
+            std::ofstream out{args[2]};
+            if (!out) {
+                std::cerr << "Cannot open " << args[2] << std::endl;
+                return;
+            }
+            stats::report_json(out);
+        }
+    } else if (is_prefix(args[1], "memory")) {
+        report_dwarf_memory(m_dwarf, std::cout);
+    } else if (is_prefix(args[1], "reset")) {
+        stats::reset();
+    } else {
+        std::cerr << "Unknown stats command\n";
+    }
+}
+
+// catch syscall [name...|off]: stop when the program enters the given syscalls, all filtered ones without names
+void debugger::handle_catch_command(const std::vector<std::string> &args) {
+    if (args.size() < 2 || !is_prefix(args[1], "syscall")) {
+        std::cerr << "Usage: catch syscall [name...|off]\n";
+        return;
+    }
+    if (m_filtered_syscalls.empty()) {
+        std::cerr << "No syscalls are filtered, start the debugger with --syscalls <name,name...>\n";
+        return;
+    }
+
+    if (args.size() == 2) {
+        m_caught_syscalls = m_filtered_syscalls;
+        std::cout << "Catching all filtered syscalls" << std::endl;
+        return;
+    }
+    if (args[2] == "off") {
+        m_caught_syscalls.clear();
+        return;
+    }
+    for (std::size_t i = 2; i < args.size(); ++i) {
+        if (args[i].empty()) {
+            continue;
+        }
+        auto info = find_syscall(args[i]);
+        if (!info) {
+            std::cerr << "Unknown syscall " << args[i] << std::endl;
+        } else if (!m_filtered_syscalls.count(info->number)) {
+            // the filter is installed before the program starts and can't be extended
+            std::cerr << args[i] << " is not filtered, add it to --syscalls" << std::endl;
+        } else {
+            m_caught_syscalls.insert(info->number);
+            std::cout << "Catching syscall " << info->name << std::endl;
+        }
+    }
+}
+
+// trace-syscalls [on|off]: print the filtered syscalls with their arguments and results as the program makes them
+void debugger::handle_trace_syscalls_command(const std::vector<std::string> &args) {
+    if (m_filtered_syscalls.empty()) {
+        std::cerr << "No syscalls are filtered, start the debugger with --syscalls <name,name...>\n";
+        return;
+    }
+    m_trace_syscalls = args.size() < 2 || args[1] != "off";
+}
+
+// find [/b|/h|/w|/g] <start> <end|+length> <pattern...>, find-all [/b|/h|/w|/g] <pattern...>: search the mapped
+// memory in the range, or all of it, for strings and integers, see parse_search_pattern
+void debugger::handle_find_command(const std::vector<std::string> &args, bool all) {
+    constexpr std::size_t max_matches = 1000;
+
+    std::size_t next = 1;
+    char size = 0;
+    if (next < args.size() && args[next].size() == 2 && args[next][0] == '/') {
+        size = args[next++][1];
+    }
+
+    constexpr auto max_address = std::numeric_limits<std::uintptr_t>::max();
+    std::uintptr_t start = 0;
+    auto end = max_address;
+    if (!all) {
+        if (next + 2 >= args.size()) {
+            std::cerr << "Usage: find [/b|/h|/w|/g] <start> <end|+length> <pattern...>\n";
+            return;
+        }
+        // stoull would take signs and leading spaces as well
+        auto parse_address = [](const std::string &text, const char *what, std::uintptr_t &out) {
+            std::size_t parsed = 0;
+            try {
+                if (!text.empty() && std::isdigit(static_cast<unsigned char>(text[0]))) {
+                    out = std::stoull(text, &parsed, 0);
+                }
+            } catch (std::logic_error &) {
+                parsed = 0;
+            }
+            if (parsed == 0 || parsed != text.size()) {
+                std::cerr << "Invalid " << what << ": " << text << std::endl;
+                return false;
+            }
+            return true;
+        };
+        // like gdb's find, +length is a length and anything else the end address
+        const auto &end_text = args[next + 1];
+        bool is_length = !end_text.empty() && end_text[0] == '+';
+        if (!parse_address(args[next], "start address", start) ||
+            !parse_address(is_length ? end_text.substr(1) : end_text, is_length ? "length" : "end address", end)) {
+            return;
+        }
+        next += 2;
+        if (is_length) {
+            // which stops at the top of the address space
+            end = start + std::min(end, max_address - start);
+        } else if (end <= start) {
+            std::cerr << "The end address has to be above the start, use +<length> for a length" << std::endl;
+            return;
+        }
+    }
+
+    std::vector<std::uint8_t> pattern;
+    try {
+        std::string pattern_text;
+        for (; next < args.size(); ++next) {
+            pattern_text += args[next] + ' ';
+        }
+        pattern = parse_search_pattern(pattern_text, size);
+    } catch (std::logic_error &e) {
+        std::cerr << "Invalid pattern: " << e.what() << std::endl;
+        return;
+    }
+
+    // readable mappings within the range, adjacent ones merged so matches may cross from one into the next
+    auto regions = read_memory_map(m_pid);
+    std::vector<search_range> ranges;
+    for (const auto &region : regions) {
+        auto range_start = std::max(region.start, start);
+        auto range_end = std::min(region.end, end);
+        if (!region.readable || range_start >= range_end) {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().end == range_start) {
+            ranges.back().end = range_end;
+        } else {
+            ranges.push_back({range_start, range_end});
+        }
+    }
+
+    std::vector<std::pair<std::uintptr_t, std::uint8_t>> patches;
+    for (const auto &[addr, bp] : m_breakpoints) {
+        if (bp.is_enabled()) {
+            patches.emplace_back(addr, bp.get_saved_data());
+        }
+    }
+    std::sort(patches.begin(), patches.end());
+
+    auto result = search_memory(m_pid, ranges, pattern, patches, max_matches);
+
+    stats::scoped_timer timer{stats::category::output};
+    for (auto address : result.matches) {
+        std::cout << "0x" << std::hex << address;
+        auto region = std::upper_bound(regions.begin(), regions.end(), address,
+                                       [](std::uintptr_t a, const memory_region &r) { return a < r.start; });
+        if (region != regions.begin() && !std::prev(region)->path.empty()) {
+            std::cout << ' ' << std::prev(region)->path;
+        }
+        std::cout << '\n';
+    }
+    if (result.count == 0) {
+        std::cout << "Pattern not found" << std::endl;
+        return;
+    }
+    std::cout << std::dec << result.count << (result.count == 1 ? " match" : " matches") << " in "
+              << result.bytes_searched / 1024 << " KiB";
+    if (result.count > result.matches.size()) {
+        std::cout << ", showing the first " << result.matches.size();
+    }
+    std::cout << std::endl;
+}
+
 bool debugger::is_prefix(const std::string &s, const std::string &of) {
     if (s.size() > of.size())
         return false;
@@ -130,10 +388,29 @@ bool debugger::is_prefix(const std::string &s, const std::string &of) {
     return std::equal(s.begin(), s.end(), of.begin());
 }
 
-void debugger::continue_execution() {
+int debugger::continue_execution(int signal) {
+    if (m_events.has_exited()) {
+        std::cerr << "The program is not being run\n";
+        return m_last_wait_status;
+    }
     step_over_breakpoint();
-    ptrace(PTRACE_CONT, m_pid, nullptr, nullptr);
-    wait_for_signal();
+    // PTRACE_SYSCALL from a syscall entry stops at its exit, where the result of a traced call is
+    resume(m_syscall_in_flight.empty() ? PTRACE_CONT : PTRACE_SYSCALL, signal);
+    auto wait_status = wait_for_signal();
+    while (m_resume_after_stop) {
+        resume(m_syscall_in_flight.empty() ? PTRACE_CONT : PTRACE_SYSCALL);
+        wait_status = wait_for_signal();
+    }
+    return wait_status;
+}
+
+void debugger::resume(__ptrace_request request, int signal) {
+    m_registers_valid = false;
+    if (request != PTRACE_SYSCALL) {
+        // the syscall completes without an exit stop
+        m_syscall_in_flight.clear();
+    }
+    stats::ptrace(request, m_pid, nullptr, reinterpret_cast<void *>(static_cast<std::uintptr_t>(signal)));
 }
 
 void debugger::set_breakpoint_at_address(std::intptr_t addr) {
@@ -144,6 +421,7 @@ void debugger::set_breakpoint_at_address(std::intptr_t addr) {
 }
 
 void debugger::dump_registers() {
+    stats::scoped_timer timer{stats::category::output};
     for (const auto &rd:g_registers_descriptors) {
         std::cout
                 << rd.name
@@ -151,25 +429,121 @@ void debugger::dump_registers() {
                 << std::setfill('0')
                 << std::setw(16)
                 << std::hex
-                << get_register_value(m_pid, rd.r)
+                << get_register_value(get_registers(), rd.r)
                 << std::endl;
     }
 }
 
 uint64_t debugger::read_memory(uint64_t address) {
-    return ptrace(PTRACE_PEEKDATA, m_pid, address, nullptr);
+    return stats::ptrace(PTRACE_PEEKDATA, m_pid, address, nullptr);
 }
 
 void debugger::write_memory(uint64_t address, uint64_t value) {
-    ptrace(PTRACE_POKEDATA, m_pid, address, value);
+    stats::ptrace(PTRACE_POKEDATA, m_pid, address, value);
+}
+
+std::size_t debugger::read_memory(uint64_t address, void *buffer, std::size_t size) {
+    auto out = static_cast<uint8_t *>(buffer);
+    std::size_t done = 0;
+    while (done < size) {
+        iovec local{out + done, size - done};
+        iovec remote{reinterpret_cast<void *>(address + done), size - done};
+        auto n = stats::process_vm_readv(m_pid, &local, 1, &remote, 1, 0);
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+
+        // process_vm_readv stops at the first page it can't read, ptrace can still read e.g. PROT_NONE guard
+        // pages, go on word by word
+        auto word_address = (address + done) & ~uint64_t{7};
+        errno = 0;
+        auto word = stats::ptrace(PTRACE_PEEKDATA, m_pid, word_address, nullptr);
+        if (errno) {
+            break;
+        }
+        auto skip = address + done - word_address;
+        auto n_bytes = std::min<std::size_t>(sizeof word - skip, size - done);
+        std::memcpy(out + done, reinterpret_cast<uint8_t *>(&word) + skip, n_bytes);
+        done += n_bytes;
+    }
+
+    // show the original instructions instead of the int3s
+    for (const auto &[addr, bp] : m_breakpoints) {
+        auto a = static_cast<uint64_t>(addr);
+        if (bp.is_enabled() && a >= address && a < address + done) {
+            out[a - address] = bp.get_saved_data();
+        }
+    }
+    return done;
+}
+
+std::size_t debugger::write_memory(uint64_t address, const void *buffer, std::size_t size) {
+    // lift the breakpoints in the way and set them again on the new instructions
+    std::vector<breakpoint *> lifted;
+    for (auto &[addr, bp] : m_breakpoints) {
+        auto a = static_cast<uint64_t>(addr);
+        if (bp.is_enabled() && a >= address && a < address + size) {
+            bp.disable();
+            lifted.push_back(&bp);
+        }
+    }
+
+    auto in = static_cast<const uint8_t *>(buffer);
+    std::size_t done = 0;
+    while (done < size) {
+        iovec local{const_cast<uint8_t *>(in) + done, size - done};
+        iovec remote{reinterpret_cast<void *>(address + done), size - done};
+        auto n = stats::process_vm_writev(m_pid, &local, 1, &remote, 1, 0);
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+
+        // read-only pages, like the program's code, can only be written through ptrace
+        auto word_address = (address + done) & ~uint64_t{7};
+        errno = 0;
+        auto word = stats::ptrace(PTRACE_PEEKDATA, m_pid, word_address, nullptr);
+        if (errno) {
+            break;
+        }
+        auto skip = address + done - word_address;
+        auto n_bytes = std::min<std::size_t>(sizeof word - skip, size - done);
+        std::memcpy(reinterpret_cast<uint8_t *>(&word) + skip, in + done, n_bytes);
+        if (stats::ptrace(PTRACE_POKEDATA, m_pid, word_address, word) == -1) {
+            break;
+        }
+        done += n_bytes;
+    }
+
+    for (auto *bp : lifted) {
+        bp->enable();
+    }
+    return done;
+}
+
+const user_regs_struct &debugger::get_registers() {
+    if (!m_registers_valid) {
+        stats::ptrace(PTRACE_GETREGS, m_pid, nullptr, &m_registers);
+        m_registers_valid = true;
+    }
+    return m_registers;
+}
+
+void debugger::set_registers(const user_regs_struct &regs) {
+    m_registers = regs;
+    m_registers_valid = true;
+    stats::ptrace(PTRACE_SETREGS, m_pid, nullptr, &m_registers);
 }
 
 uint64_t debugger::get_pc() {
-    return get_register_value(m_pid, reg::rip);
+    return get_registers().rip;
 }
 
 void debugger::set_pc(uint64_t pc) {
-    set_register_value(m_pid, reg::rip, pc);
+    auto regs = get_registers();
+    regs.rip = pc;
+    set_registers(regs);
 }
 
 void debugger::step_over_breakpoint() {
@@ -177,18 +551,44 @@ void debugger::step_over_breakpoint() {
         auto &bp = m_breakpoints[get_pc()];
         if (bp.is_enabled()) {
             bp.disable();
-            ptrace(PTRACE_SINGLESTEP, m_pid, nullptr, nullptr);
+            resume(PTRACE_SINGLESTEP);
             wait_for_signal();
             bp.enable();
         }
     }
 }
 
-// encapsulate waitpid syscall
-void debugger::wait_for_signal() {
-    int wait_status;
-    auto options = 0;
-    waitpid(m_pid, &wait_status, options);
+// wait for the inferior to stop, the prompt stays live meanwhile. Returns the wait status
+int debugger::wait_for_signal() {
+    auto wait_status = m_events.wait_for_stop();
+    m_last_wait_status = wait_status;
+    m_registers_valid = false;
+    m_resume_after_stop = false;
+
+    if (WIFEXITED(wait_status)) {
+        std::cout << "Program exited with status " << std::dec << WEXITSTATUS(wait_status) << std::endl;
+        return wait_status;
+    }
+    if (WIFSIGNALED(wait_status)) {
+        std::cout << "Program terminated by signal " << strsignal(WTERMSIG(wait_status)) << std::endl;
+        return wait_status;
+    }
+    // PTRACE_INTERRUPT stops a seized tracee with PTRACE_EVENT_STOP instead of a signal
+    if (wait_status >> 16 == PTRACE_EVENT_STOP) {
+        handle_interrupt();
+        return wait_status;
+    }
+    // the seccomp filter stops the program at the entry of the filtered syscalls, PTRACE_SYSCALL at their exit,
+    // which PTRACE_O_TRACESYSGOOD tells apart from a SIGTRAP
+    if (wait_status >> 8 == (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))) {
+        m_resume_after_stop = !handle_syscall_entry();
+        return wait_status;
+    }
+    if (WSTOPSIG(wait_status) == (SIGTRAP | 0x80)) {
+        handle_syscall_exit();
+        m_resume_after_stop = true;
+        return wait_status;
+    }
 
     auto siginfo = get_signal_info();
     switch (siginfo.si_signo) {
@@ -201,18 +601,80 @@ void debugger::wait_for_signal() {
         default:
             std::cout << "Got signal " << strsignal(siginfo.si_signo) << std::endl;
     }
+    return wait_status;
+}
+
+auto debugger::get_last_wait_status() const -> int {
+    return m_last_wait_status;
+}
+
+event_loop &debugger::get_event_loop() {
+    return m_events;
+}
+
+void debugger::handle_interrupt() {
+    std::cout << "Interrupted at address 0x" << std::hex << get_pc() << std::endl;
+    try {
+        auto line_entry = get_line_entry_from_pc(get_pc());
+        print_source(line_entry->file->path, line_entry->line);
+    } catch (std::out_of_range &) {
+        // somewhere without debug info, e.g. in libc
+    }
+}
 
+void debugger::set_filtered_syscalls(const std::vector<long> &numbers) {
+    m_filtered_syscalls = {numbers.begin(), numbers.end()};
+}
+
+auto debugger::has_syscall_filter() const -> bool {
+    return !m_filtered_syscalls.empty();
+}
+
+bool debugger::handle_syscall_entry() {
+    const auto &regs = get_registers();
+    // at a syscall entry the number is in orig_rax, rax holds -ENOSYS
+    auto caught = m_caught_syscalls.count(static_cast<long>(regs.orig_rax)) > 0;
+    if (!caught && !m_trace_syscalls) {
+        return false;
+    }
+
+    stats::scoped_timer timer{stats::category::output};
+    auto call = format_syscall(regs, [this](uint64_t address, void *buffer, std::size_t size) {
+        return read_memory(address, buffer, size);
+    });
+    if (caught) {
+        std::cout << "Caught syscall " << call << " at 0x" << std::hex << regs.rip << std::endl;
+    }
+    if (m_trace_syscalls) {
+        m_syscall_in_flight = std::move(call);
+    }
+    return caught;
+}
+
+void debugger::handle_syscall_exit() {
+    if (m_syscall_in_flight.empty()) {
+        return;
+    }
+    stats::scoped_timer timer{stats::category::output};
+    std::cout << m_syscall_in_flight << " = " << format_syscall_result(get_registers()) << std::endl;
+    m_syscall_in_flight.clear();
 }
 
 // debugging information entry (DIE)
 dwarf::die debugger::get_function_from_pc(uint64_t pc) {
+    stats::scoped_timer timer{stats::category::dwarf};
     for (auto &cu: m_dwarf.compilation_units()) {
         if (die_pc_range(cu.root()).contains(pc)) {
-            for (const auto &die: cu.root()) {
-                if (die.tag == dwarf::DW_TAG::subprogram) {
-                    if (die_pc_range(die).contains(pc)) {
-                        return die;
-                    }
+            // with split DWARF the skeleton only has the ranges and the DIEs are in the .dwo
+            const auto &dies = cu.get_split_unit().get_die_table();
+            for (dwarf::die_table::index i = 0; i < dies.size(); ++i) {
+                if (dies.tag(i) != dwarf::DW_TAG::subprogram ||
+                    !(dies.has(i, dwarf::DW_AT::low_pc) || dies.has(i, dwarf::DW_AT::ranges))) {
+                    continue;
+                }
+                auto die = dies.get_die(i);
+                if (die_pc_range(die).contains(pc)) {
+                    return die;
                 }
             }
         }
@@ -223,6 +685,7 @@ dwarf::die debugger::get_function_from_pc(uint64_t pc) {
 // simply find the correct compilation unit, then ask the line table to get us
 // the relevant entry
 dwarf::line_table::iterator debugger::get_line_entry_from_pc(uint64_t pc) {
+    stats::scoped_timer timer{stats::category::dwarf};
     for (auto &cu: m_dwarf.compilation_units()) {
         if (die_pc_range(cu.root()).contains(pc)) {
             auto &lt = cu.get_line_table();
@@ -238,6 +701,7 @@ dwarf::line_table::iterator debugger::get_line_entry_from_pc(uint64_t pc) {
 }
 
 void debugger::print_source(const std::string &file_name, unsigned line, unsigned n_lines_context) {
+    stats::scoped_timer timer{stats::category::output};
     std::ifstream file{file_name};
 
     auto start_line = line <= n_lines_context ? 1 : line - n_lines_context;
@@ -274,7 +738,7 @@ void debugger::print_source(const std::string &file_name, unsigned line, unsigne
 // how in was produced;
 siginfo_t debugger::get_signal_info() {
     siginfo_t info;
-    ptrace(PTRACE_GETSIGINFO, m_pid, nullptr, &info);
+    stats::ptrace(PTRACE_GETSIGINFO, m_pid, nullptr, &info);
     return info;
 }
 
@@ -286,9 +750,13 @@ void debugger::handle_sigtrap(siginfo_t info) {
         case TRAP_BRKPT: {
             set_pc(get_pc() - 1); //put the pc back where is should be
             std::cout << "Hit breakpoint at address 0x" << std::hex << get_pc() << std::endl;
-            auto line_entry = get_line_entry_from_pc(get_pc());
-            print_source(line_entry->file->path, line_entry->line);
-            return;;
+            try {
+                auto line_entry = get_line_entry_from_pc(get_pc());
+                print_source(line_entry->file->path, line_entry->line);
+            } catch (std::out_of_range &) {
+                // a breakpoint without debug info, e.g. one set by a remote client in libc
+            }
+            return;
         }
         case TRAP_TRACE:
             return;
@@ -299,7 +767,10 @@ void debugger::handle_sigtrap(siginfo_t info) {
 }
 
 void debugger::single_step_instruction() {
-    ptrace(PTRACE_SINGLESTEP, m_pid, nullptr, nullptr);
+    if (m_events.has_exited()) {
+        return;
+    }
+    resume(PTRACE_SINGLESTEP);
     wait_for_signal();
 }
 
@@ -314,7 +785,7 @@ void debugger::single_step_instruction_with_breakpoint_check() {
 }
 
 void debugger::step_out() {
-    auto frame_pointer = get_register_value(m_pid, reg::rbp);
+    auto frame_pointer = get_registers().rbp;
     auto return_address = read_memory(frame_pointer + 8);
 
     bool should_remove_breakpoint = false;
@@ -366,7 +837,7 @@ void debugger::step_over() {
         ++line;
     }
 
-    auto frame_pointer = get_register_value(m_pid, reg::rbp);
+    auto frame_pointer = get_registers().rbp;
     auto return_address = read_memory(frame_pointer + 8);
 
     if (!m_breakpoints.count(return_address)) {
@@ -381,11 +852,48 @@ void debugger::step_over() {
     }
 }
 
+// name of the subprogram DIE i. Out-of-line definitions of functions in namespaces and classes carry no name, it's
+// on the declaration their DW_AT_specification points to, or on the DW_AT_abstract_origin of concrete instances
+const char *get_subprogram_name(const dwarf::compilation_unit &cu, dwarf::die_table::index i, std::size_t *len) {
+    const auto &dies = cu.get_die_table();
+    // a definition may point to an abstract instance which points to the declaration
+    for (int depth = 0; depth < 4 && i != dwarf::die_table::npos; ++depth) {
+        if (auto name = dies.get_cstr(i, dwarf::DW_AT::name, len)) {
+            return name;
+        }
+
+        dwarf::DW_AT link;
+        if (dies.has(i, dwarf::DW_AT::specification)) {
+            link = dwarf::DW_AT::specification;
+        } else if (dies.has(i, dwarf::DW_AT::abstract_origin)) {
+            link = dwarf::DW_AT::abstract_origin;
+        } else {
+            return nullptr;
+        }
+        auto target = dies.get(i, link).as_reference();
+        if (target.get_unit().get_section_offset() != cu.get_section_offset()) {
+            // DW_FORM_ref_addr into another unit, rare enough to not index
+            return nullptr;
+        }
+        i = dies.find(target.get_unit_offset());
+    }
+    return nullptr;
+}
+
 void debugger::set_breakpoint_at_function(const std::string &name) {
-    for (const auto &cu : m_dwarf.compilation_units()) {
-        for (const auto &die: cu.root()) {
-            if (die.has(dwarf::DW_AT::name) && at_name(die) == name) {
-                auto low_pc = at_low_pc(die);
+    stats::scoped_timer timer{stats::category::dwarf};
+    for (const auto &skeleton : m_dwarf.compilation_units()) {
+        // scan the flat DIE table, names are compared in place without copying them out of .debug_str
+        const auto &cu = skeleton.get_split_unit();
+        const auto &dies = cu.get_die_table();
+        for (dwarf::die_table::index i = 0; i < dies.size(); ++i) {
+            if (dies.tag(i) != dwarf::DW_TAG::subprogram || !dies.has(i, dwarf::DW_AT::low_pc)) {
+                continue;
+            }
+            std::size_t len;
+            const char *die_name = get_subprogram_name(cu, i, &len);
+            if (die_name && std::string_view{die_name, len} == name) {
+                auto low_pc = at_low_pc(dies.get_die(i));
                 auto entry = get_line_entry_from_pc(low_pc);
                 ++entry; //skip prologue
                 set_breakpoint_at_address(entry->address);
@@ -395,6 +903,7 @@ void debugger::set_breakpoint_at_function(const std::string &name) {
 }
 
 void debugger::set_breakpoint_at_source_line(const std::string &file, unsigned line) {
+    stats::scoped_timer timer{stats::category::dwarf};
     for (const auto &cu: m_dwarf.compilation_units()) {
         const auto &lt = cu.get_line_table();
 
@@ -408,16 +917,25 @@ void debugger::set_breakpoint_at_source_line(const std::string &file, unsigned l
 }
 
 std::vector<symbol> debugger::lookup_symbol(const std::string &name) {
+    stats::scoped_timer timer{stats::category::dwarf};
     std::vector<symbol> syms;
 
-    for (auto &sec:m_elf.sections()) {
-        if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym) {
-            continue;
-        }
-        for (const auto &sym: sec.as_symtab()) {
-            if (sym.get_name() == name) {
-                auto &d = sym.get_data();
-                syms.push_back((symbol{to_symbol_type(d.type()), sym.get_name(), d.value}));
+    // a stripped binary only has .dynsym, the full .symtab lives in the separate debug file
+    std::vector<elf::elf> files{m_elf};
+    if (m_debug_elf != m_elf && !m_elf.get_section(".symtab").valid()) {
+        files.push_back(m_debug_elf);
+    }
+
+    for (const auto &file: files) {
+        for (auto &sec:file.sections()) {
+            if (sec.get_hdr().type != elf::sht::symtab && sec.get_hdr().type != elf::sht::dynsym) {
+                continue;
+            }
+            for (const auto &sym: sec.as_symtab()) {
+                if (sym.get_name() == name) {
+                    auto &d = sym.get_data();
+                    syms.push_back((symbol{to_symbol_type(d.type()), sym.get_name(), d.value}));
+                }
             }
         }
     }
@@ -0,0 +1,410 @@
+#include "../include/event_loop.h"
+#include "../include/stats.h"
+#include "linenoise.h"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/ptrace.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+// state shared between the loop and the thread blocked in linenoise. The thread can't be woken up while it's
+// reading, so it's detached and keeps this alive until it notices the loop is gone
+struct event_loop::input {
+    std::mutex mutex;
+    std::condition_variable line_wanted;
+    std::string prompt;
+    bool want_line = false;
+    bool stopping = false;
+    bool closed = false;
+    unsigned interrupts = 0; // Ctrl-C at the prompt
+    std::deque<std::string> lines;
+    int event_fd;
+
+    input() : event_fd{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)} {
+        if (event_fd == -1) {
+            throw std::runtime_error{"eventfd failed"};
+        }
+    }
+
+    ~input() {
+        close(event_fd);
+    }
+
+    void run() {
+        for (;;) {
+            {
+                std::unique_lock lock{mutex};
+                line_wanted.wait(lock, [this] { return want_line || stopping; });
+                if (stopping) {
+                    return;
+                }
+                want_line = false;
+            }
+
+            // linenoise returns nullptr with EAGAIN for Ctrl-C and without it at the end of input
+            errno = 0;
+            char *line = linenoise(prompt.c_str());
+            bool done = false;
+            {
+                std::lock_guard lock{mutex};
+                if (line) {
+                    linenoiseHistoryAdd(line);
+                    lines.emplace_back(line);
+                    linenoiseFree(line);
+                } else if (errno == EAGAIN) {
+                    ++interrupts;
+                } else {
+                    closed = done = true;
+                }
+            }
+
+            std::uint64_t one = 1;
+            write(event_fd, &one, sizeof one);
+            if (done) {
+                return;
+            }
+        }
+    }
+};
+
+namespace {
+
+// how long the inferior has to run before the prompt comes back, so single steps don't flash it
+constexpr auto prompt_delay = std::chrono::milliseconds{100};
+
+void add_to_epoll(int epoll_fd, int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        throw std::runtime_error{"epoll_ctl failed"};
+    }
+}
+
+// the stop of a process at a fork, vfork or clone, with PTRACE_O_TRACEFORK and friends
+bool is_new_tracee_event(int wait_status) {
+    auto event = wait_status >> 16;
+    return WIFSTOPPED(wait_status) &&
+           (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE);
+}
+
+bool is_interrupt_command(const std::string &line) {
+    auto command = line.substr(0, line.find(' '));
+    return !command.empty() && std::string{"interrupt"}.compare(0, command.size(), command) == 0;
+}
+
+} // namespace
+
+event_loop::event_loop(pid_t pid) : m_pid{pid} {
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        throw std::runtime_error{"epoll_create1 failed"};
+    }
+
+    // a pidfd only becomes readable when the process exits, ptrace stops are reported to the tracer with
+    // SIGCHLD. Both are blocked and read from a signalfd, which covers exits too when there is no pidfd_open
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    m_signal_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (m_signal_fd == -1) {
+        throw std::runtime_error{"signalfd failed"};
+    }
+    add_to_epoll(m_epoll_fd, m_signal_fd);
+
+#ifdef SYS_pidfd_open
+    m_pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (m_pid_fd != -1) {
+        add_to_epoll(m_epoll_fd, m_pid_fd);
+    }
+#endif
+}
+
+event_loop::~event_loop() {
+    if (m_input) {
+        std::lock_guard lock{m_input->mutex};
+        m_input->stopping = true;
+        m_input->line_wanted.notify_one();
+    }
+    if (m_pid_fd != -1) {
+        close(m_pid_fd);
+    }
+    close(m_signal_fd);
+    close(m_epoll_fd);
+}
+
+void event_loop::enable_input(std::string prompt) {
+    if (m_input) {
+        return;
+    }
+
+    // Ctrl-C only reaches us as a signal when linenoise isn't reading, e.g. with input from a pipe
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    signalfd(m_signal_fd, &mask, 0);
+
+    m_input = std::make_shared<input>();
+    m_input->prompt = std::move(prompt);
+    add_to_epoll(m_epoll_fd, m_input->event_fd);
+
+    // started after blocking the signals above, so the thread inherits the mask
+    std::thread{[in = m_input] { in->run(); }}.detach();
+}
+
+std::optional<std::string> event_loop::read_line() {
+    if (!m_input) {
+        return std::nullopt;
+    }
+
+    for (;;) {
+        if (!m_lines.empty()) {
+            auto line = std::move(m_lines.front());
+            m_lines.pop_front();
+            return line;
+        }
+        if (!m_line_requested) {
+            std::lock_guard lock{m_input->mutex};
+            if (m_input->closed && m_input->lines.empty()) {
+                return std::nullopt;
+            }
+        }
+        request_line();
+        wait_once(run_idle_task() ? 0 : -1);
+    }
+}
+
+int event_loop::wait_for_stop() {
+    if (m_exited) {
+        return m_exit_status;
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto prompt_at = clock::now() + prompt_delay;
+    m_running = true;
+
+    for (;;) {
+        int wait_status;
+        auto pid = stats::waitpid(-1, &wait_status, WNOHANG | __WALL);
+        if (pid == m_pid && is_new_tracee_event(wait_status)) {
+            add_new_tracee(m_pid);
+            stats::ptrace(PTRACE_CONT, m_pid, nullptr, nullptr);
+            continue;
+        }
+        if (pid > 0 && pid != m_pid) {
+            resume_other_tracee(pid, wait_status);
+            continue;
+        }
+        if (pid == m_pid) {
+            m_running = false;
+            if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+                m_exited = true;
+                m_exit_status = wait_status;
+                // an exited process' pidfd stays readable
+                if (m_pid_fd != -1) {
+                    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_pid_fd, nullptr);
+                    close(m_pid_fd);
+                    m_pid_fd = -1;
+                }
+            }
+            return wait_status;
+        }
+
+        int timeout = -1;
+        if (m_input && !m_line_requested) {
+            auto now = clock::now();
+            if (now >= prompt_at) {
+                request_line();
+            } else {
+                timeout = static_cast<int>(
+                        std::chrono::ceil<std::chrono::milliseconds>(prompt_at - now).count());
+            }
+        }
+        if (run_idle_task()) {
+            timeout = 0;
+        }
+
+        stats::scoped_timer timer{stats::category::wait};
+        wait_once(timeout);
+    }
+}
+
+void event_loop::interrupt() {
+    if (m_exited) {
+        return;
+    }
+    if (stats::ptrace(PTRACE_INTERRUPT, m_pid, nullptr, nullptr) == -1) {
+        kill(m_pid, SIGSTOP);
+    }
+}
+
+void event_loop::add_idle_task(std::function<bool()> task) {
+    m_idle_tasks.push_back(std::move(task));
+}
+
+auto event_loop::has_exited() const -> bool {
+    return m_exited;
+}
+
+void event_loop::watch(int fd, std::function<void()> on_readable) {
+    add_to_epoll(m_epoll_fd, fd);
+    m_watched[fd] = std::move(on_readable);
+}
+
+void event_loop::unwatch(int fd) {
+    if (m_watched.erase(fd)) {
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+void event_loop::wait_once(int timeout_ms) {
+    epoll_event events[8];
+    auto n = epoll_wait(m_epoll_fd, events, 8, timeout_ms);
+    for (int i = 0; i < n; ++i) {
+        auto fd = events[i].data.fd;
+        if (m_input && fd == m_input->event_fd) {
+            take_input();
+        } else if (fd == m_signal_fd) {
+            take_signals();
+        } else if (auto it = m_watched.find(fd); it != m_watched.end()) {
+            // the callback may unwatch, keep it alive until it returns
+            auto on_readable = it->second;
+            on_readable();
+        }
+        // a readable pidfd means the inferior exited, which waitpid collects in wait_for_stop
+    }
+}
+
+void event_loop::request_line() {
+    if (m_line_requested) {
+        return;
+    }
+    std::lock_guard lock{m_input->mutex};
+    // the reader is gone after the end of input, read_line sees it as long as no line is requested
+    if (m_input->closed) {
+        return;
+    }
+    m_line_requested = true;
+    m_input->want_line = true;
+    m_input->line_wanted.notify_one();
+}
+
+void event_loop::take_input() {
+    std::uint64_t count;
+    read(m_input->event_fd, &count, sizeof count);
+
+    std::deque<std::string> lines;
+    unsigned interrupts;
+    {
+        std::lock_guard lock{m_input->mutex};
+        lines.swap(m_input->lines);
+        interrupts = m_input->interrupts;
+        m_input->interrupts = 0;
+        // the reader waits for the next request after every line, Ctrl-C and the end of input
+        m_line_requested = false;
+    }
+
+    if (interrupts && m_running) {
+        interrupt();
+    }
+    for (auto &line : lines) {
+        handle_line(std::move(line));
+    }
+}
+
+void event_loop::take_signals() {
+    signalfd_siginfo info{};
+    bool child_stopped = false;
+    while (read(m_signal_fd, &info, sizeof info) == sizeof info) {
+        // Ctrl-C on the terminal goes to the inferior as well, only pass on the ones sent to us alone
+        if (info.ssi_signo == SIGINT && info.ssi_code == SI_USER && m_running) {
+            interrupt();
+        }
+        child_stopped |= info.ssi_signo == SIGCHLD;
+    }
+    // while the inferior runs, wait_for_stop collects everything
+    if (child_stopped && !m_running) {
+        reap_other_tracees();
+    }
+}
+
+void event_loop::add_new_tracee(pid_t parent) {
+    unsigned long pid;
+    if (stats::ptrace(PTRACE_GETEVENTMSG, parent, nullptr, &pid) != -1) {
+        m_other_tracees.insert(static_cast<pid_t>(pid));
+    }
+}
+
+void event_loop::resume_other_tracee(pid_t pid, int wait_status) {
+    if (WIFEXITED(wait_status) || WIFSIGNALED(wait_status)) {
+        m_other_tracees.erase(pid);
+        return;
+    }
+    // a new tracee may stop before its parent's fork event is seen
+    m_other_tracees.insert(pid);
+    if (is_new_tracee_event(wait_status)) {
+        add_new_tracee(pid);
+    }
+
+    int signal = 0;
+    auto event = wait_status >> 16;
+    if (event == PTRACE_EVENT_STOP && WSTOPSIG(wait_status) != SIGTRAP) {
+        // a group stop, e.g. from SIGSTOP, which lasts until SIGCONT. A new tracee's first stop has SIGTRAP
+        stats::ptrace(PTRACE_LISTEN, pid, nullptr, nullptr);
+        return;
+    }
+    if (event == 0) {
+        // a signal for the tracee, delivered as it resumes
+        signal = WSTOPSIG(wait_status);
+    }
+    // seccomp stops let the syscall run as if there were no filter
+    stats::ptrace(PTRACE_CONT, pid, nullptr, reinterpret_cast<void *>(static_cast<std::uintptr_t>(signal)));
+}
+
+void event_loop::reap_other_tracees() {
+    bool reaped;
+    do {
+        reaped = false;
+        std::vector<pid_t> pids{m_other_tracees.begin(), m_other_tracees.end()};
+        for (auto pid : pids) {
+            int wait_status;
+            if (stats::waitpid(pid, &wait_status, WNOHANG | __WALL) == pid) {
+                resume_other_tracee(pid, wait_status);
+                reaped = true;
+            }
+        }
+    } while (reaped);
+}
+
+void event_loop::handle_line(std::string line) {
+    if (m_running && is_interrupt_command(line)) {
+        interrupt();
+        return;
+    }
+    if (m_running) {
+        std::cout << "The program is running, \"" << line << "\" will run when it stops" << std::endl;
+    }
+    m_lines.push_back(std::move(line));
+}
+
+auto event_loop::run_idle_task() -> bool {
+    while (!m_idle_tasks.empty()) {
+        if (m_idle_tasks.front()()) {
+            return true;
+        }
+        m_idle_tasks.erase(m_idle_tasks.begin());
+    }
+    return false;
+}
@@ -0,0 +1,828 @@
+#include "../include/gdb_server.h"
+#include "../include/debugger.h"
+#include "../include/memory_map.h"
+#include "../include/stats.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <climits>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// the registers of the 'g' packet in GDB's amd64 numbering, the general purpose ones are 8 bytes, eflags and
+// the segment registers 4
+struct gdb_register {
+    std::size_t offset; // in user_regs_struct
+    std::size_t size;
+};
+
+const gdb_register g_gdb_registers[] = {
+        {offsetof(user_regs_struct, rax), 8},
+        {offsetof(user_regs_struct, rbx), 8},
+        {offsetof(user_regs_struct, rcx), 8},
+        {offsetof(user_regs_struct, rdx), 8},
+        {offsetof(user_regs_struct, rsi), 8},
+        {offsetof(user_regs_struct, rdi), 8},
+        {offsetof(user_regs_struct, rbp), 8},
+        {offsetof(user_regs_struct, rsp), 8},
+        {offsetof(user_regs_struct, r8), 8},
+        {offsetof(user_regs_struct, r9), 8},
+        {offsetof(user_regs_struct, r10), 8},
+        {offsetof(user_regs_struct, r11), 8},
+        {offsetof(user_regs_struct, r12), 8},
+        {offsetof(user_regs_struct, r13), 8},
+        {offsetof(user_regs_struct, r14), 8},
+        {offsetof(user_regs_struct, r15), 8},
+        {offsetof(user_regs_struct, rip), 8},
+        {offsetof(user_regs_struct, eflags), 4},
+        {offsetof(user_regs_struct, cs), 4},
+        {offsetof(user_regs_struct, ss), 4},
+        {offsetof(user_regs_struct, ds), 4},
+        {offsetof(user_regs_struct, es), 4},
+        {offsetof(user_regs_struct, fs), 4},
+        {offsetof(user_regs_struct, gs), 4},
+};
+
+constexpr std::size_t n_gdb_registers = sizeof g_gdb_registers / sizeof g_gdb_registers[0];
+
+// sent along with every stop so the client can show where it stopped without asking: rbp, rsp and rip
+constexpr unsigned g_expedited_registers[] = {6, 7, 16};
+
+// GDB numbers signals its own way, the first 15 agree with Linux
+int to_gdb_signal(int signal) {
+    switch (signal) {
+        case SIGBUS:
+            return 10;
+        case SIGUSR1:
+            return 30;
+        case SIGUSR2:
+            return 31;
+        case SIGCHLD:
+            return 20;
+        case SIGCONT:
+            return 19;
+        case SIGSTOP:
+            return 17;
+        case SIGTSTP:
+            return 18;
+        case SIGTTIN:
+            return 21;
+        case SIGTTOU:
+            return 22;
+        case SIGURG:
+            return 16;
+        case SIGIO:
+            return 23;
+        case SIGSYS:
+            return 12;
+        default:
+            return signal < 16 ? signal : 0;
+    }
+}
+
+int from_gdb_signal(int signal) {
+    for (int s = 1; s < NSIG; ++s) {
+        if (to_gdb_signal(s) == signal) {
+            return s;
+        }
+    }
+    return 0;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// consumes the hex number at the front of s
+std::uint64_t parse_hex(std::string_view &s) {
+    std::uint64_t value = 0;
+    std::size_t i = 0;
+    for (; i < s.size() && hex_value(s[i]) >= 0; ++i) {
+        value = value << 4 | hex_value(s[i]);
+    }
+    s.remove_prefix(i);
+    return value;
+}
+
+// consumes "addr,len" and the separator behind it
+bool parse_address_and_length(std::string_view &s, std::uint64_t &address, std::uint64_t &length) {
+    address = parse_hex(s);
+    if (s.empty() || s.front() != ',') {
+        return false;
+    }
+    s.remove_prefix(1);
+    length = parse_hex(s);
+    if (!s.empty()) {
+        s.remove_prefix(1);
+    }
+    return true;
+}
+
+bool needs_escape(char c) {
+    return c == '$' || c == '#' || c == '}' || c == '*';
+}
+
+void append_xml_escaped(std::string &out, const std::string &s) {
+    for (char c : s) {
+        switch (c) {
+            case '&':
+                out += "&amp;";
+                break;
+            case '<':
+                out += "&lt;";
+                break;
+            case '>':
+                out += "&gt;";
+                break;
+            case '"':
+                out += "&quot;";
+                break;
+            default:
+                out += c;
+        }
+    }
+}
+
+const char g_hex_digits[] = "0123456789abcdef";
+
+} // namespace
+
+gdb_server::gdb_server(debugger &dbg, pid_t pid)
+        : m_dbg{dbg}, m_pid{pid}, m_last_status{(SIGTRAP << 8) | 0x7f},
+          m_in(2 * packet_size + 16), m_out(2 * packet_size + 16) {
+}
+
+gdb_server::~gdb_server() {
+    if (m_client_fd != -1) {
+        m_dbg.get_event_loop().unwatch(m_client_fd);
+        close(m_client_fd);
+    }
+    if (m_listen_fd != -1) {
+        close(m_listen_fd);
+    }
+    if (!m_socket_path.empty()) {
+        unlink(m_socket_path.c_str());
+    }
+}
+
+void gdb_server::accept_client(const std::string &address) {
+    bool is_port = !address.empty() && std::all_of(address.begin(), address.end(), ::isdigit);
+
+    if (is_port) {
+        m_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int on = 1;
+        setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::stoul(address)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(m_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == -1) {
+            throw std::runtime_error{"cannot listen on port " + address + ": " + strerror(errno)};
+        }
+    } else {
+        sockaddr_un addr{};
+        if (address.size() >= sizeof addr.sun_path) {
+            throw std::runtime_error{"socket path too long: " + address};
+        }
+        m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, address.c_str());
+        unlink(address.c_str());
+        if (bind(m_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == -1) {
+            throw std::runtime_error{"cannot listen on " + address + ": " + strerror(errno)};
+        }
+        m_socket_path = address;
+    }
+
+    listen(m_listen_fd, 1);
+    std::cout << "Listening on " << (is_port ? "port " : "") << address << std::endl;
+    m_client_fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (m_client_fd == -1) {
+        throw std::runtime_error{std::string{"accept failed: "} + strerror(errno)};
+    }
+    if (is_port) {
+        int on = 1;
+        setsockopt(m_client_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    }
+
+    // Ctrl-C in the client arrives as a lone 0x03 while the program runs. It's taken out of the buffer here, the
+    // stop reply goes out when the program stops
+    m_dbg.get_event_loop().watch(m_client_fd, [this] {
+        auto pending = m_in_end - m_in_begin; // receive may move the pending bytes to the front
+        if (!receive()) {
+            m_dbg.get_event_loop().interrupt();
+            return;
+        }
+        auto *received = m_in.data() + m_in_begin + pending;
+        auto *end = m_in.data() + m_in_end;
+        if (m_running && std::find(received, end, '\x03') != end) {
+            m_in_end = std::remove(received, end, '\x03') - m_in.data();
+            m_dbg.get_event_loop().interrupt();
+        }
+    });
+}
+
+void gdb_server::run() {
+    while (!m_done) {
+        if (!process_input() && !receive()) {
+            break;
+        }
+    }
+}
+
+bool gdb_server::receive() {
+    if (m_client_fd == -1) {
+        return false;
+    }
+
+    // move what's left of a partial packet to the front to make room
+    if (m_in_begin) {
+        std::memmove(m_in.data(), m_in.data() + m_in_begin, m_in_end - m_in_begin);
+        m_in_end -= m_in_begin;
+        m_in_begin = 0;
+    }
+    if (m_in_end == m_in.size()) {
+        throw std::runtime_error{"packet larger than the announced packet size"};
+    }
+
+    auto n = recv(m_client_fd, m_in.data() + m_in_end, m_in.size() - m_in_end, 0);
+    if (n <= 0) {
+        m_dbg.get_event_loop().unwatch(m_client_fd);
+        close(m_client_fd);
+        m_client_fd = -1;
+        return false;
+    }
+    m_in_end += n;
+    return true;
+}
+
+// handles the next complete packet in the receive buffer, false if there is none
+auto gdb_server::process_input() -> bool {
+    while (m_in_begin < m_in_end) {
+        switch (m_in[m_in_begin]) {
+            case '+':
+                ++m_in_begin;
+                continue;
+            case '-':
+                ++m_in_begin;
+                send_raw(m_out.data(), m_out_size);
+                continue;
+            case '$':
+                break;
+            case '\x03':
+                // the program is already stopped, the client still waits for a stop reply
+                ++m_in_begin;
+                stop_reply();
+                return true;
+            default:
+                // line noise
+                ++m_in_begin;
+                continue;
+        }
+
+        auto *begin = m_in.data() + m_in_begin;
+        auto *end = m_in.data() + m_in_end;
+        auto *hash = std::find(begin + 1, end, '#');
+        if (end - hash < 3) {
+            return false;
+        }
+
+        unsigned char checksum = 0;
+        for (auto *c = begin + 1; c != hash; ++c) {
+            checksum += static_cast<unsigned char>(*c);
+        }
+        auto expected = hex_value(hash[1]) << 4 | hex_value(hash[2]);
+        m_in_begin = hash + 3 - m_in.data();
+
+        if (!m_no_ack) {
+            send_raw(checksum == expected ? "+" : "-", 1);
+        }
+        if (checksum == expected || m_no_ack) {
+            handle_packet(begin + 1, hash - begin - 1);
+        }
+        return true;
+    }
+    return false;
+}
+
+void gdb_server::handle_packet(char *data, std::size_t size) {
+    std::string_view packet{data, size};
+    begin_reply();
+
+    if (packet.empty()) {
+        send_reply();
+        return;
+    }
+
+    auto args = packet.substr(1);
+    switch (packet.front()) {
+        case '?':
+            stop_reply();
+            return;
+        case 'g':
+            read_registers();
+            break;
+        case 'G':
+            write_registers(args);
+            break;
+        case 'p':
+            read_register(args);
+            break;
+        case 'P':
+            write_register(args);
+            break;
+        case 'm':
+            read_memory_hex(args);
+            break;
+        case 'M':
+            write_memory_hex(args);
+            break;
+        case 'x':
+            read_memory_binary(args);
+            break;
+        case 'X':
+            write_memory_binary(data + 1, size - 1);
+            break;
+        case 'Z':
+        case 'z':
+            set_breakpoint(args, packet.front() == 'Z');
+            break;
+        case 'H':
+            append("OK");
+            break;
+        case 'T':
+            append("OK"); // the only thread is alive as long as we are
+            break;
+        case 'c':
+        case 's':
+            if (!args.empty()) {
+                m_dbg.set_pc(parse_hex(args));
+            }
+            resume(packet.front() == 's', 0);
+            return;
+        case 'C':
+        case 'S': {
+            auto signal = from_gdb_signal(static_cast<int>(parse_hex(args)));
+            if (!args.empty() && args.front() == ';') {
+                args.remove_prefix(1);
+                m_dbg.set_pc(parse_hex(args));
+            }
+            resume(packet.front() == 'S', signal);
+            return;
+        }
+        case 'D':
+            // the filter stays after a detach and makes the filtered syscalls fail without a tracer
+            if (m_dbg.has_syscall_filter()) {
+                append("E01");
+                break;
+            }
+            for (auto addr : m_breakpoints) {
+                m_dbg.remove_breakpoint(addr);
+            }
+            m_breakpoints.clear();
+            stats::ptrace(PTRACE_DETACH, m_pid, nullptr, nullptr);
+            append("OK");
+            send_reply();
+            m_done = true;
+            return;
+        case 'k':
+            kill(m_pid, SIGKILL);
+            m_done = true;
+            return;
+        case 'q':
+        case 'Q':
+            handle_query(packet);
+            send_reply();
+            m_no_ack = m_no_ack || packet == "QStartNoAckMode";
+            return;
+        case 'v':
+            if (packet == "vCont?") {
+                append("vCont;c;C;s;S");
+            } else if (packet.substr(0, 6) == "vCont;") {
+                handle_vcont(packet.substr(6));
+                return;
+            } else if (packet.substr(0, 6) == "vKill;") {
+                kill(m_pid, SIGKILL);
+                append("OK");
+                send_reply();
+                m_done = true;
+                return;
+            }
+            // anything else, like vMustReplyEmpty, is unsupported
+            break;
+        default:
+            break;
+    }
+    send_reply();
+}
+
+void gdb_server::handle_query(std::string_view packet) {
+    if (packet.substr(0, 10) == "qSupported") {
+        append("PacketSize=");
+        append_hex_number(packet_size);
+        append(";QStartNoAckMode+;qXfer:libraries:read+;qXfer:threads:read+;vContSupported+;binary-upload+");
+    } else if (packet == "QStartNoAckMode") {
+        append("OK"); // handle_packet turns the acks off once this is sent, the OK itself is still acknowledged
+    } else if (packet == "qAttached") {
+        append("0"); // we started it, the client kills it when it quits
+    } else if (packet == "qC") {
+        append("QC");
+        append_hex_number(m_pid);
+    } else if (packet == "qfThreadInfo") {
+        append("m");
+        append_hex_number(m_pid);
+    } else if (packet == "qsThreadInfo") {
+        append("l");
+    } else if (packet.substr(0, 6) == "qXfer:") {
+        // qXfer:object:read:annex:offset,length
+        auto rest = packet.substr(6);
+        auto colon = rest.find(':');
+        auto object = rest.substr(0, colon);
+        rest.remove_prefix(colon == std::string_view::npos ? rest.size() : colon + 1);
+        if (rest.substr(0, 5) == "read:") {
+            handle_xfer(object, rest.substr(5));
+        }
+    }
+}
+
+void gdb_server::handle_xfer(std::string_view object, std::string_view annex_and_range) {
+    std::string document;
+    if (object == "threads") {
+        document = threads_xml();
+    } else if (object == "libraries") {
+        document = libraries_xml();
+    } else {
+        return;
+    }
+
+    auto range = annex_and_range.substr(annex_and_range.find(':') + 1);
+    std::uint64_t offset, length;
+    if (!parse_address_and_length(range, offset, length)) {
+        append("E01");
+        return;
+    }
+    if (offset >= document.size()) {
+        append("l");
+        return;
+    }
+
+    // leave room for the escapes
+    length = std::min<std::uint64_t>(length, packet_size / 2);
+    auto chunk = std::string_view{document}.substr(offset, length);
+    append(offset + chunk.size() < document.size() ? "m" : "l");
+    append_binary(chunk.data(), chunk.size());
+}
+
+void gdb_server::handle_vcont(std::string_view actions) {
+    // vCont;action[:thread-id];... there is one thread, so the first action is the one for it
+    auto action = actions.substr(0, actions.find(';'));
+    action = action.substr(0, action.find(':'));
+    if (action.empty()) {
+        append("E01");
+        send_reply();
+        return;
+    }
+
+    auto kind = action.front();
+    action.remove_prefix(1);
+    auto signal = (kind == 'C' || kind == 'S') ? from_gdb_signal(static_cast<int>(parse_hex(action))) : 0;
+    if (kind == 'c' || kind == 'C' || kind == 's' || kind == 'S') {
+        resume(kind == 's' || kind == 'S', signal);
+    } else {
+        send_reply(); // unsupported action
+    }
+}
+
+void gdb_server::resume(bool step, int signal) {
+    m_running = true;
+    if (step) {
+        // a step doesn't deliver the signal, the next continue does
+        m_dbg.single_step_instruction_with_breakpoint_check();
+        m_last_status = m_dbg.get_last_wait_status();
+    } else {
+        m_last_status = m_dbg.continue_execution(signal);
+    }
+    m_running = false;
+    stop_reply();
+}
+
+void gdb_server::stop_reply() {
+    begin_reply();
+    auto status = m_last_status;
+
+    if (WIFEXITED(status)) {
+        char code[3] = {'W', g_hex_digits[WEXITSTATUS(status) >> 4], g_hex_digits[WEXITSTATUS(status) & 0xf]};
+        append(std::string_view{code, 3});
+        m_done = true;
+    } else if (WIFSIGNALED(status)) {
+        auto signal = to_gdb_signal(WTERMSIG(status));
+        char code[3] = {'X', g_hex_digits[signal >> 4], g_hex_digits[signal & 0xf]};
+        append(std::string_view{code, 3});
+        m_done = true;
+    } else {
+        // an interrupt shows up as PTRACE_EVENT_STOP, for the client it's a SIGINT
+        auto signal = status >> 16 == PTRACE_EVENT_STOP ? to_gdb_signal(SIGINT) : to_gdb_signal(WSTOPSIG(status));
+        char code[3] = {'T', g_hex_digits[signal >> 4], g_hex_digits[signal & 0xf]};
+        append(std::string_view{code, 3});
+        append("thread:");
+        append_hex_number(m_pid);
+        append(";");
+
+        const auto &regs = m_dbg.get_registers();
+        for (auto n : g_expedited_registers) {
+            char number[2] = {g_hex_digits[n >> 4], g_hex_digits[n & 0xf]};
+            append(std::string_view{number, 2});
+            append(":");
+            append_hex(reinterpret_cast<const char *>(&regs) + g_gdb_registers[n].offset, g_gdb_registers[n].size);
+            append(";");
+        }
+    }
+    send_reply();
+}
+
+void gdb_server::read_registers() {
+    const auto &regs = m_dbg.get_registers();
+    for (const auto &r : g_gdb_registers) {
+        append_hex(reinterpret_cast<const char *>(&regs) + r.offset, r.size);
+    }
+}
+
+void gdb_server::write_registers(std::string_view hex) {
+    auto regs = m_dbg.get_registers();
+    auto *bytes = reinterpret_cast<char *>(&regs);
+    for (const auto &r : g_gdb_registers) {
+        if (hex.size() < 2 * r.size) {
+            break;
+        }
+        // the upper half of the 4 byte registers stays as it was
+        for (std::size_t i = 0; i < r.size; ++i) {
+            bytes[r.offset + i] = static_cast<char>(hex_value(hex[2 * i]) << 4 | hex_value(hex[2 * i + 1]));
+        }
+        hex.remove_prefix(2 * r.size);
+    }
+    m_dbg.set_registers(regs);
+    append("OK");
+}
+
+void gdb_server::read_register(std::string_view packet) {
+    auto n = parse_hex(packet);
+    if (n >= n_gdb_registers) {
+        append("E01");
+        return;
+    }
+    const auto &regs = m_dbg.get_registers();
+    append_hex(reinterpret_cast<const char *>(&regs) + g_gdb_registers[n].offset, g_gdb_registers[n].size);
+}
+
+void gdb_server::write_register(std::string_view packet) {
+    auto n = parse_hex(packet);
+    if (n >= n_gdb_registers || packet.empty() || packet.front() != '=' ||
+        packet.size() < 1 + 2 * g_gdb_registers[n].size) {
+        append("E01");
+        return;
+    }
+    packet.remove_prefix(1);
+    auto regs = m_dbg.get_registers();
+    auto *bytes = reinterpret_cast<char *>(&regs) + g_gdb_registers[n].offset;
+    for (std::size_t i = 0; i < g_gdb_registers[n].size; ++i) {
+        bytes[i] = static_cast<char>(hex_value(packet[2 * i]) << 4 | hex_value(packet[2 * i + 1]));
+    }
+    m_dbg.set_registers(regs);
+    append("OK");
+}
+
+void gdb_server::read_memory_hex(std::string_view packet) {
+    std::uint64_t address, length;
+    if (!parse_address_and_length(packet, address, length)) {
+        append("E01");
+        return;
+    }
+    length = std::min<std::uint64_t>(length, packet_size / 2);
+
+    // read into the second half of the hex text's place and encode forward, every byte is read before the
+    // digits overwrite it
+    auto *out = m_out.data() + m_out_size;
+    auto *raw = reinterpret_cast<unsigned char *>(out + length);
+    auto n = m_dbg.read_memory(address, raw, length);
+    if (!n && length) {
+        append("E01");
+        return;
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+        auto byte = raw[i];
+        out[2 * i] = g_hex_digits[byte >> 4];
+        out[2 * i + 1] = g_hex_digits[byte & 0xf];
+    }
+    m_out_size += 2 * n;
+}
+
+void gdb_server::write_memory_hex(std::string_view packet) {
+    std::uint64_t address, length;
+    if (!parse_address_and_length(packet, address, length) || packet.size() < 2 * length) {
+        append("E01");
+        return;
+    }
+
+    // decode in place, the bytes take half the room of their digits
+    auto *bytes = const_cast<char *>(packet.data());
+    for (std::size_t i = 0; i < length; ++i) {
+        bytes[i] = static_cast<char>(hex_value(packet[2 * i]) << 4 | hex_value(packet[2 * i + 1]));
+    }
+    append(m_dbg.write_memory(address, bytes, length) == length ? "OK" : "E01");
+}
+
+void gdb_server::read_memory_binary(std::string_view packet) {
+    std::uint64_t address, length;
+    if (!parse_address_and_length(packet, address, length)) {
+        append("E01");
+        return;
+    }
+    length = std::min<std::uint64_t>(length, packet_size - 1);
+
+    append("b");
+    // the same trick as for hex: read behind the place of the escaped data, escaping never catches up with
+    // the byte being read. What doesn't fit in a packet after escaping is left for the next read
+    auto *out = m_out.data() + m_out_size;
+    auto *raw = out + length;
+    auto n = m_dbg.read_memory(address, raw, length);
+    if (!n && length) {
+        m_out_size -= 1;
+        append("E01");
+        return;
+    }
+    std::size_t written = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        auto c = raw[i];
+        if (needs_escape(c)) {
+            if (written + 2 > packet_size - 1) {
+                break;
+            }
+            out[written++] = '}';
+            out[written++] = static_cast<char>(c ^ 0x20);
+        } else {
+            if (written + 1 > packet_size - 1) {
+                break;
+            }
+            out[written++] = c;
+        }
+    }
+    m_out_size += written;
+}
+
+void gdb_server::write_memory_binary(char *data, std::size_t size) {
+    std::string_view packet{data, size};
+    std::uint64_t address, length;
+    if (!parse_address_and_length(packet, address, length)) {
+        append("E01");
+        return;
+    }
+
+    // unescape in place
+    auto *in = const_cast<char *>(packet.data());
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < packet.size() && n < length; ++i) {
+        in[n++] = packet[i] == '}' && i + 1 < packet.size() ? static_cast<char>(packet[++i] ^ 0x20) : packet[i];
+    }
+    if (n != length) {
+        append("E01");
+        return;
+    }
+    append(!length || m_dbg.write_memory(address, in, length) == length ? "OK" : "E01");
+}
+
+void gdb_server::set_breakpoint(std::string_view packet, bool insert) {
+    // type,addr,kind, only software breakpoints
+    if (packet.empty() || packet.front() != '0') {
+        return; // unsupported, empty reply
+    }
+    packet.remove_prefix(std::min<std::size_t>(2, packet.size()));
+    auto address = static_cast<std::uintptr_t>(parse_hex(packet));
+
+    if (insert && !m_breakpoints.count(address)) {
+        m_dbg.set_breakpoint_at_address(address);
+        m_breakpoints.insert(address);
+    } else if (!insert && m_breakpoints.count(address)) {
+        m_dbg.remove_breakpoint(address);
+        m_breakpoints.erase(address);
+    }
+    append("OK");
+}
+
+std::string gdb_server::threads_xml() const {
+    std::string xml = "<?xml version=\"1.0\"?>\n<threads>\n";
+    char id[32];
+    snprintf(id, sizeof id, "%x", m_pid);
+    xml += "  <thread id=\"";
+    xml += id;
+    xml += "\"/>\n</threads>\n";
+    return xml;
+}
+
+std::string gdb_server::libraries_xml() const {
+    char exe[PATH_MAX];
+    auto exe_size = readlink(("/proc/" + std::to_string(m_pid) + "/exe").c_str(), exe, sizeof exe - 1);
+    std::string exe_path{exe, static_cast<std::size_t>(std::max<ssize_t>(exe_size, 0))};
+
+    // every mapped file but the executable, at the address of its first mapping
+    std::string xml = "<?xml version=\"1.0\"?>\n<library-list>\n";
+    std::set<std::string> seen;
+    for (const auto &region : read_memory_map(m_pid)) {
+        if (region.path.empty() || region.path.front() == '[' || region.path == exe_path ||
+            region.offset != 0 || !seen.insert(region.path).second) {
+            continue;
+        }
+        char address[32];
+        snprintf(address, sizeof address, "0x%lx", static_cast<unsigned long>(region.start));
+        xml += "  <library name=\"";
+        append_xml_escaped(xml, region.path);
+        xml += "\"><segment address=\"";
+        xml += address;
+        xml += "\"/></library>\n";
+    }
+    xml += "</library-list>\n";
+    return xml;
+}
+
+void gdb_server::begin_reply() {
+    m_out[0] = '$';
+    m_out_size = 1;
+}
+
+void gdb_server::append(std::string_view text) {
+    std::memcpy(m_out.data() + m_out_size, text.data(), text.size());
+    m_out_size += text.size();
+}
+
+void gdb_server::append_hex(const void *data, std::size_t size) {
+    auto *bytes = static_cast<const unsigned char *>(data);
+    auto *out = m_out.data() + m_out_size;
+    for (std::size_t i = 0; i < size; ++i) {
+        out[2 * i] = g_hex_digits[bytes[i] >> 4];
+        out[2 * i + 1] = g_hex_digits[bytes[i] & 0xf];
+    }
+    m_out_size += 2 * size;
+}
+
+void gdb_server::append_hex_number(std::uint64_t value) {
+    char digits[16];
+    std::size_t n = 0;
+    do {
+        digits[n++] = g_hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+    while (n) {
+        m_out[m_out_size++] = digits[--n];
+    }
+}
+
+void gdb_server::append_binary(const void *data, std::size_t size) {
+    auto *bytes = static_cast<const char *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        if (needs_escape(bytes[i])) {
+            m_out[m_out_size++] = '}';
+            m_out[m_out_size++] = static_cast<char>(bytes[i] ^ 0x20);
+        } else {
+            m_out[m_out_size++] = bytes[i];
+        }
+    }
+}
+
+void gdb_server::send_reply() {
+    unsigned char checksum = 0;
+    for (std::size_t i = 1; i < m_out_size; ++i) {
+        checksum += static_cast<unsigned char>(m_out[i]);
+    }
+    m_out[m_out_size++] = '#';
+    m_out[m_out_size++] = g_hex_digits[checksum >> 4];
+    m_out[m_out_size++] = g_hex_digits[checksum & 0xf];
+    send_raw(m_out.data(), m_out_size);
+}
+
+void gdb_server::send_raw(const char *data, std::size_t size) {
+    while (size && m_client_fd != -1) {
+        auto n = send(m_client_fd, data, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        data += n;
+        size -= n;
+    }
+}
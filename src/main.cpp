@@ -4,33 +4,149 @@
 
 #include "../include/main.h"
 #include "../include/debugger.h"
+#include "../include/gdb_server.h"
+#include "../include/syscalls.h"
 #include <sys/ptrace.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include <signal.h>
+#include <wait.h>
 #include <zconf.h>
 
+// why the child didn't get as far as running the program, sent to the parent over a close-on-exec pipe that a
+// successful exec closes without writing anything
+struct launch_error {
+    enum { filter, exec } step;
+    int error; // errno
+};
+
+// seizes the stopped child and resumes it up to the exec of the debuggee. Unlike PTRACE_TRACEME, PTRACE_SEIZE
+// lets `interrupt` stop the debuggee with PTRACE_INTERRUPT. The seccomp options are set before the child installs its
+// syscall filter, see main. The filter is inherited by the debuggee's children and threads, whose filtered syscalls
+// fail with ENOSYS unless they are traced too, so with a filter they are, like strace --seccomp-bpf does
+bool seize(pid_t pid, bool filtered) {
+    int wait_status;
+    waitpid(pid, &wait_status, WSTOPPED);
+    auto options = PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL | PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD;
+    if (filtered) {
+        options |= PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE;
+    }
+    if (ptrace(PTRACE_SEIZE, pid, nullptr, options) == -1) {
+        return false;
+    }
+    kill(pid, SIGCONT);
+
+    // the seize and SIGCONT stop the child on the way, the exec event stop is where debugging starts
+    while (waitpid(pid, &wait_status, __WALL) == pid && WIFSTOPPED(wait_status)) {
+        if (wait_status >> 8 == (SIGTRAP | (PTRACE_EVENT_EXEC << 8))) {
+            return true;
+        }
+        ptrace(PTRACE_CONT, pid, nullptr, nullptr);
+    }
+    return false;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
+    // debugger [--server <port|unix-socket>] [--syscalls <name,name...>] program
+    std::string server_address;
+    std::vector<long> syscalls;
+    int arg = 1;
+    for (; arg + 1 < argc; arg += 2) {
+        std::string option{argv[arg]};
+        if (option == "--server") {
+            server_address = argv[arg + 1];
+        } else if (option == "--syscalls") {
+            std::stringstream names{argv[arg + 1]};
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                auto info = find_syscall(name);
+                if (!info) {
+                    std::cerr << "Unknown syscall " << name << std::endl;
+                    return -1;
+                }
+                syscalls.push_back(info->number);
+            }
+        } else {
+            break;
+        }
+    }
+    if (arg >= argc) {
         std::cerr << "Program name not specified";
         return -1;
     }
+    if (syscalls.size() > max_filtered_syscalls) {
+        std::cerr << "At most " << max_filtered_syscalls << " syscalls can be filtered" << std::endl;
+        return -1;
+    }
 
-    auto prog = argv[1];
+    auto prog = argv[arg];
+    // non-blocking, so the parent can't hang on a child that never got as far as writing or exec'ing
+    int error_pipe[2];
+    if (pipe2(error_pipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+        perror("pipe2");
+        return -1;
+    }
     auto pid = fork();
 
     if (pid == 0) {
         // we're in the child
         // exec debugee
 
-        //PTRACE_TRACEME in linux systems
-        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
-        execl(prog, prog, nullptr);
+        close(error_pipe[0]);
+        // wait for the parent to seize us
+        kill(getpid(), SIGSTOP);
+
+        // only the selected syscalls stop the debuggee, the others run at full speed. Without the filter the
+        // debugger would wait for syscall stops that never come, so the launch stops here
+        launch_error error{launch_error::filter, 0};
+        if (syscalls.empty() || install_syscall_filter(syscalls)) {
+            execl(prog, prog, nullptr);
+            error.step = launch_error::exec;
+        }
+        error.error = errno;
+        write(error_pipe[1], &error, sizeof error);
+        _exit(127);
 
     } else if (pid >= 1) {
         //we're in the parent process
         // exec debugger
+        close(error_pipe[1]);
+        // the child has exec'd or exited once seize returns, unless seizing failed
+        bool started = seize(pid, !syscalls.empty());
+        launch_error error{};
+        auto error_size = read(error_pipe[0], &error, sizeof error);
+        close(error_pipe[0]);
+        if (error_size == sizeof error) {
+            if (error.step == launch_error::filter) {
+                std::cerr << "Cannot install the syscall filter: " << strerror(error.error) << std::endl;
+            } else {
+                std::cerr << "Cannot run " << prog << ": " << strerror(error.error) << std::endl;
+            }
+            return -1;
+        }
+        if (!started) {
+            std::cerr << "Cannot start " << prog << std::endl;
+            return -1;
+        }
         debugger dbg{prog, pid};
-        dbg.run();
+        dbg.set_filtered_syscalls(syscalls);
+        if (server_address.empty()) {
+            dbg.run();
+            return 0;
+        }
+
+        try {
+            gdb_server server{dbg, pid};
+            server.accept_client(server_address);
+            server.run();
+        } catch (std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
     }
 }
-
-
@@ -0,0 +1,33 @@
+#include "../include/memory_map.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+std::vector<memory_region> read_memory_map(pid_t pid) {
+    std::ifstream maps{"/proc/" + std::to_string(pid) + "/maps"};
+    if (!maps) {
+        throw std::runtime_error{"cannot read the memory map of process " + std::to_string(pid)};
+    }
+
+    // start-end perms offset dev inode path, e.g.
+    // 00400000-00401000 r--p 00000000 08:01 1234 /usr/bin/prog
+    std::vector<memory_region> regions;
+    std::string line;
+    while (std::getline(maps, line)) {
+        std::istringstream in{line};
+        memory_region region{};
+        std::string range, perms, dev;
+        std::uint64_t inode;
+        in >> range >> perms >> std::hex >> region.offset >> dev >> std::dec >> inode;
+        std::getline(in >> std::ws, region.path);
+
+        auto dash = range.find('-');
+        region.start = std::stoull(range.substr(0, dash), nullptr, 16);
+        region.end = std::stoull(range.substr(dash + 1), nullptr, 16);
+        region.readable = perms[0] == 'r';
+        region.writable = perms[1] == 'w';
+        region.executable = perms[2] == 'x';
+        regions.push_back(std::move(region));
+    }
+    return regions;
+}
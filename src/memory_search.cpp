@@ -0,0 +1,387 @@
+#include "../include/memory_search.h"
+#include "../include/stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <sys/uio.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr std::size_t chunk_size = 1 << 20;
+
+// a piece of a range, read with the first bytes of the next one so matches can cross into it
+struct chunk {
+    std::uintptr_t address;
+    std::size_t starts; // positions a match may start at, the rest belongs to the next chunk
+    std::size_t size;
+};
+
+struct chunk_matches {
+    std::uintptr_t address;
+    std::vector<std::uintptr_t> &out; // the pipeline's, for all of its chunks
+    std::size_t max_matches;
+    std::uint64_t &count;
+
+    void add(std::size_t offset) {
+        ++count;
+        // a pipeline gets its chunks in ascending order and searches them front to back, so once it has max_matches
+        // none of its later ones can be among the lowest
+        if (out.size() < max_matches) {
+            out.push_back(address + offset);
+        }
+    }
+};
+
+using search_kernel = void (*)(const std::uint8_t *data, std::size_t starts, const std::uint8_t *pattern,
+                               std::size_t size, chunk_matches &matches);
+
+void search_scalar(const std::uint8_t *data, std::size_t begin, std::size_t starts, const std::uint8_t *pattern,
+                   std::size_t size, chunk_matches &matches) {
+    auto p = data + begin;
+    auto end = data + starts;
+    while (p < end && (p = static_cast<const std::uint8_t *>(std::memchr(p, pattern[0], end - p)))) {
+        if (std::memcmp(p, pattern, size) == 0) {
+            matches.add(p - data);
+        }
+        ++p;
+    }
+}
+
+#if defined(__x86_64__)
+
+// the SIMD kernels compare a block of positions against the first and the last byte of the pattern at once and
+// only compare the whole pattern where both match, which rules out almost every position for anything but runs
+// of the same byte
+
+__attribute__((target("avx2")))
+void search_avx2(const std::uint8_t *data, std::size_t starts, const std::uint8_t *pattern, std::size_t size,
+                 chunk_matches &matches) {
+    auto first = _mm256_set1_epi8(static_cast<char>(pattern[0]));
+    auto last = _mm256_set1_epi8(static_cast<char>(pattern[size - 1]));
+    std::size_t i = 0;
+    for (; i + 32 <= starts; i += 32) {
+        auto block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        auto block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + size - 1));
+        auto eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+        auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+        while (mask) {
+            auto offset = i + __builtin_ctz(mask);
+            if (std::memcmp(data + offset, pattern, size) == 0) {
+                matches.add(offset);
+            }
+            mask &= mask - 1;
+        }
+    }
+    search_scalar(data, i, starts, pattern, size, matches);
+}
+
+// SSE2 is part of x86-64, so this one needs no check
+void search_sse2(const std::uint8_t *data, std::size_t starts, const std::uint8_t *pattern, std::size_t size,
+                 chunk_matches &matches) {
+    auto first = _mm_set1_epi8(static_cast<char>(pattern[0]));
+    auto last = _mm_set1_epi8(static_cast<char>(pattern[size - 1]));
+    std::size_t i = 0;
+    for (; i + 16 <= starts; i += 16) {
+        auto block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + size - 1));
+        auto eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+        while (mask) {
+            auto offset = i + __builtin_ctz(mask);
+            if (std::memcmp(data + offset, pattern, size) == 0) {
+                matches.add(offset);
+            }
+            mask &= mask - 1;
+        }
+    }
+    search_scalar(data, i, starts, pattern, size, matches);
+}
+
+#else
+
+void search_scalar(const std::uint8_t *data, std::size_t starts, const std::uint8_t *pattern, std::size_t size,
+                   chunk_matches &matches) {
+    search_scalar(data, 0, starts, pattern, size, matches);
+}
+
+#endif
+
+search_kernel pick_kernel() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return search_avx2;
+    }
+    return search_sse2;
+#else
+    return search_scalar;
+#endif
+}
+
+struct buffer {
+    std::vector<std::uint8_t> data;
+    std::size_t chunk = 0;
+    std::size_t size = 0; // bytes read
+};
+
+// a reader and a searcher pass two buffers back and forth, so reading the next chunk overlaps searching this one
+struct pipeline {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<buffer *> empty;
+    std::deque<buffer *> full;
+    bool reading_done = false;
+    buffer buffers[2];
+
+    std::vector<std::uintptr_t> matches;
+    std::uint64_t count = 0;
+    std::uint64_t bytes_searched = 0;
+};
+
+void read_chunks(pid_t pid, const std::vector<chunk> &chunks, std::atomic<std::size_t> &next_chunk, pipeline &p) {
+    for (;;) {
+        auto index = next_chunk++;
+        if (index >= chunks.size()) {
+            break;
+        }
+
+        buffer *b;
+        {
+            std::unique_lock lock{p.mutex};
+            p.changed.wait(lock, [&p] { return !p.empty.empty(); });
+            b = p.empty.front();
+            p.empty.pop_front();
+        }
+
+        const auto &c = chunks[index];
+        iovec local{b->data.data(), c.size};
+        iovec remote{reinterpret_cast<void *>(c.address), c.size};
+        // a mapping that went away or can't be read, e.g. [vvar], is just skipped
+        auto n = stats::process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        b->chunk = index;
+        b->size = n > 0 ? static_cast<std::size_t>(n) : 0;
+
+        {
+            std::lock_guard lock{p.mutex};
+            p.full.push_back(b);
+        }
+        p.changed.notify_all();
+    }
+
+    {
+        std::lock_guard lock{p.mutex};
+        p.reading_done = true;
+    }
+    p.changed.notify_all();
+}
+
+void search_chunks(const std::vector<chunk> &chunks, const std::vector<std::uint8_t> &pattern,
+                   const std::vector<std::pair<std::uintptr_t, std::uint8_t>> &patches, std::size_t max_matches,
+                   search_kernel kernel, pipeline &p) {
+    for (;;) {
+        buffer *b;
+        {
+            std::unique_lock lock{p.mutex};
+            p.changed.wait(lock, [&p] { return !p.full.empty() || p.reading_done; });
+            if (p.full.empty()) {
+                break;
+            }
+            b = p.full.front();
+            p.full.pop_front();
+        }
+
+        const auto &c = chunks[b->chunk];
+        auto begin = std::lower_bound(patches.begin(), patches.end(), std::make_pair(c.address, std::uint8_t{0}));
+        for (auto it = begin; it != patches.end() && it->first < c.address + b->size; ++it) {
+            b->data[it->first - c.address] = it->second;
+        }
+
+        if (b->size >= pattern.size()) {
+            auto starts = std::min(c.starts, b->size - pattern.size() + 1);
+            chunk_matches matches{c.address, p.matches, max_matches, p.count};
+            kernel(b->data.data(), starts, pattern.data(), pattern.size(), matches);
+            p.bytes_searched += starts;
+        }
+
+        {
+            std::lock_guard lock{p.mutex};
+            p.empty.push_back(b);
+        }
+        p.changed.notify_all();
+    }
+}
+
+} // namespace
+
+std::vector<std::uint8_t> parse_search_pattern(const std::string &pattern, char size) {
+    std::size_t width = 0;
+    switch (size) {
+        case 0:
+            break;
+        case 'b':
+            width = 1;
+            break;
+        case 'h':
+            width = 2;
+            break;
+        case 'w':
+            width = 4;
+            break;
+        case 'g':
+            width = 8;
+            break;
+        default:
+            throw std::invalid_argument{std::string{"unknown size letter "} + size};
+    }
+
+    std::vector<std::uint8_t> bytes;
+    std::size_t i = 0;
+    while (i < pattern.size()) {
+        if (pattern[i] == ' ') {
+            ++i;
+            continue;
+        }
+
+        if (pattern[i] == '"') {
+            for (++i; i < pattern.size() && pattern[i] != '"'; ++i) {
+                if (pattern[i] != '\\' || i + 1 == pattern.size()) {
+                    bytes.push_back(pattern[i]);
+                    continue;
+                }
+                switch (pattern[++i]) {
+                    case 'n':
+                        bytes.push_back('\n');
+                        break;
+                    case 't':
+                        bytes.push_back('\t');
+                        break;
+                    case '0':
+                        bytes.push_back('\0');
+                        break;
+                    case 'x': {
+                        auto digits = pattern.substr(i + 1, 2);
+                        if (digits.size() != 2 || !std::isxdigit(static_cast<unsigned char>(digits[0])) ||
+                            !std::isxdigit(static_cast<unsigned char>(digits[1]))) {
+                            throw std::invalid_argument{"\\x needs two hex digits: \\x" + digits};
+                        }
+                        bytes.push_back(static_cast<std::uint8_t>(std::stoul(digits, nullptr, 16)));
+                        i += 2;
+                        break;
+                    }
+                    default:
+                        bytes.push_back(pattern[i]);
+                }
+            }
+            if (i == pattern.size()) {
+                throw std::invalid_argument{"unterminated string"};
+            }
+            ++i;
+            continue;
+        }
+
+        auto end = pattern.find(' ', i);
+        auto token = pattern.substr(i, end == std::string::npos ? std::string::npos : end - i);
+        i += token.size();
+
+        std::size_t parsed = 0;
+        std::uint64_t value = 0;
+        bool negative = token[0] == '-';
+        try {
+            if (negative) {
+                value = static_cast<std::uint64_t>(std::stoll(token, &parsed, 0));
+            } else {
+                value = std::stoull(token, &parsed, 0);
+            }
+        } catch (std::out_of_range &) {
+            throw std::invalid_argument{token + " doesn't fit in 8 bytes"};
+        } catch (std::invalid_argument &) {
+        }
+        if (parsed != token.size()) {
+            throw std::invalid_argument{"not a number: " + token};
+        }
+
+        auto fits = [value, negative](std::size_t w) {
+            if (w == 8) {
+                return true;
+            }
+            auto bits = 8 * w;
+            if (negative) {
+                return static_cast<std::int64_t>(value) >= -(std::int64_t{1} << (bits - 1));
+            }
+            return value < (std::uint64_t{1} << bits);
+        };
+        auto w = width ? width : fits(4) ? 4 : 8;
+        if (!fits(w)) {
+            throw std::invalid_argument{token + " doesn't fit in " + std::to_string(w) + " bytes"};
+        }
+        for (std::size_t b = 0; b < w; ++b) {
+            bytes.push_back(static_cast<std::uint8_t>(value >> (8 * b)));
+        }
+    }
+
+    if (bytes.empty()) {
+        throw std::invalid_argument{"empty pattern"};
+    }
+    return bytes;
+}
+
+search_result search_memory(pid_t pid, const std::vector<search_range> &ranges, const std::vector<std::uint8_t> &pattern,
+                            const std::vector<std::pair<std::uintptr_t, std::uint8_t>> &patches,
+                            std::size_t max_matches) {
+    std::vector<chunk> chunks;
+    for (const auto &range : ranges) {
+        for (auto address = range.start; address < range.end; address += chunk_size) {
+            auto starts = std::min<std::size_t>(chunk_size, range.end - address);
+            auto size = std::min<std::size_t>(starts + pattern.size() - 1, range.end - address);
+            chunks.push_back({address, starts, size});
+        }
+    }
+
+    search_result result;
+    if (chunks.empty()) {
+        return result;
+    }
+
+    // one reader and one searcher per pipeline, the readers mostly wait for the kernel to copy memory
+    auto n_pipelines = std::clamp<std::size_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+    n_pipelines = std::min(n_pipelines, chunks.size());
+    auto kernel = pick_kernel();
+
+    std::vector<std::unique_ptr<pipeline>> pipelines;
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> next_chunk{0};
+    for (std::size_t i = 0; i < n_pipelines; ++i) {
+        auto &p = *pipelines.emplace_back(std::make_unique<pipeline>());
+        for (auto &b : p.buffers) {
+            b.data.resize(chunk_size + pattern.size() - 1);
+            p.empty.push_back(&b);
+        }
+        threads.emplace_back(read_chunks, pid, std::cref(chunks), std::ref(next_chunk), std::ref(p));
+        threads.emplace_back(search_chunks, std::cref(chunks), std::cref(pattern), std::cref(patches),
+                             max_matches, kernel, std::ref(p));
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    for (const auto &p : pipelines) {
+        result.matches.insert(result.matches.end(), p->matches.begin(), p->matches.end());
+        result.count += p->count;
+        result.bytes_searched += p->bytes_searched;
+    }
+    std::sort(result.matches.begin(), result.matches.end());
+    if (result.matches.size() > max_matches) {
+        result.matches.resize(max_matches);
+    }
+    return result;
+}
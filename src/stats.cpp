@@ -0,0 +1,440 @@
+#include "../include/stats.h"
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace stats {
+
+namespace {
+
+// every thread's counters, so the report can sum them up. Threads merge theirs into exited when
+// they go away
+struct registry {
+    std::mutex mutex;
+    std::vector<thread_stats *> threads;
+    thread_stats exited;
+};
+
+auto get_registry() -> registry & {
+    static registry r;
+    return r;
+}
+
+// registers the thread's counters on first use
+struct registered_thread_stats {
+    thread_stats stats;
+
+    registered_thread_stats() {
+        auto &r = get_registry();
+        std::lock_guard lock{r.mutex};
+        r.threads.push_back(&stats);
+    }
+
+    ~registered_thread_stats() {
+        auto &r = get_registry();
+        std::lock_guard lock{r.mutex};
+        r.exited.merge(stats);
+        r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &stats));
+    }
+};
+
+// charges the time since the last switch to the current category. Time outside of any command or timer,
+// e.g. spent at the prompt, isn't charged to anything
+void charge(thread_stats &s, std::uint64_t now) {
+    if (s.active) {
+        s.time_ns[static_cast<std::size_t>(s.current)] += now - s.current_since;
+    }
+    s.current_since = now;
+}
+
+void write_duration(std::ostream &out, std::uint64_t ns) {
+    if (ns < 10000) {
+        out << ns << "ns";
+    } else if (ns < 10000000) {
+        out << ns / 1000 << "us";
+    } else {
+        out << ns / 1000000 << "ms";
+    }
+}
+
+void write_percentiles(std::ostream &out, const histogram &h) {
+    for (auto p : {50, 90, 99}) {
+        out << "  p" << p << " ";
+        write_duration(out, h.percentile(p));
+    }
+    out << "  max ";
+    write_duration(out, h.max());
+}
+
+void write_json_histogram(std::ostream &out, const histogram &h) {
+    out << "{\"count\": " << h.count() << ", \"sum_ns\": " << h.sum()
+        << ", \"p50_ns\": " << h.percentile(50) << ", \"p90_ns\": " << h.percentile(90)
+        << ", \"p99_ns\": " << h.percentile(99) << ", \"max_ns\": " << h.max() << "}";
+}
+
+void write_json_string(std::ostream &out, const std::string &s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                << std::setfill(' ') << std::dec;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+std::string to_string(syscall s) {
+    switch (s) {
+        case syscall::peekdata:
+            return "ptrace(PEEKDATA)";
+        case syscall::pokedata:
+            return "ptrace(POKEDATA)";
+        case syscall::getregs:
+            return "ptrace(GETREGS)";
+        case syscall::setregs:
+            return "ptrace(SETREGS)";
+        case syscall::cont:
+            return "ptrace(CONT)";
+        case syscall::singlestep:
+            return "ptrace(SINGLESTEP)";
+        case syscall::getsiginfo:
+            return "ptrace(GETSIGINFO)";
+        case syscall::other_ptrace:
+            return "ptrace(other)";
+        case syscall::waitpid:
+            return "waitpid";
+        case syscall::process_vm_readv:
+            return "process_vm_readv";
+        case syscall::process_vm_writev:
+            return "process_vm_writev";
+    }
+    return "unknown";
+}
+
+std::string to_string(category c) {
+    switch (c) {
+        case category::other:
+            return "other";
+        case category::ptrace:
+            return "ptrace";
+        case category::wait:
+            return "wait";
+        case category::dwarf:
+            return "dwarf";
+        case category::output:
+            return "output";
+    }
+    return "unknown";
+}
+
+auto histogram::bucket_of(std::uint64_t ns) -> std::size_t {
+    // values below 2^sub_bucket_bits get a bucket each, above that every power of two gets
+    // 2^sub_bucket_bits buckets indexed by the bits right below the leading one
+    if (ns < (1u << sub_bucket_bits)) {
+        return ns;
+    }
+    unsigned exponent = std::bit_width(ns) - 1;
+    auto sub_bucket = (ns >> (exponent - sub_bucket_bits)) & ((1u << sub_bucket_bits) - 1);
+    return ((exponent - sub_bucket_bits + 1) << sub_bucket_bits) + sub_bucket;
+}
+
+auto histogram::upper_bound_of(std::size_t bucket) -> std::uint64_t {
+    if (bucket < (1u << sub_bucket_bits)) {
+        return bucket;
+    }
+    auto exponent = (bucket >> sub_bucket_bits) + sub_bucket_bits - 1;
+    auto sub_bucket = bucket & ((1u << sub_bucket_bits) - 1);
+    auto width = std::uint64_t{1} << (exponent - sub_bucket_bits);
+    return (std::uint64_t{1} << exponent) + (sub_bucket + 1) * width - 1;
+}
+
+void histogram::record(std::uint64_t ns) {
+    ++m_buckets[bucket_of(ns)];
+    ++m_count;
+    m_sum += ns;
+    m_max = std::max(m_max, ns);
+}
+
+void histogram::merge(const histogram &other) {
+    for (std::size_t i = 0; i < n_buckets; ++i) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+auto histogram::percentile(double p) const -> std::uint64_t {
+    if (!m_count) {
+        return 0;
+    }
+    auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(p / 100 * m_count + 0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < n_buckets; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            return std::min(upper_bound_of(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+void thread_stats::merge(const thread_stats &other) {
+    for (std::size_t i = 0; i < n_syscalls; ++i) {
+        syscalls[i].merge(other.syscalls[i]);
+    }
+    for (std::size_t i = 0; i < n_categories; ++i) {
+        time_ns[i] += other.time_ns[i];
+    }
+    stop_to_prompt.merge(other.stop_to_prompt);
+    for (const auto &[name, c] : other.commands) {
+        auto &mine = commands[name];
+        mine.runs += c.runs;
+        mine.syscalls += c.syscalls;
+        mine.latency.merge(c.latency);
+    }
+    syscall_count += other.syscall_count;
+    stop_count += other.stop_count;
+}
+
+auto now_ns() -> std::uint64_t {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+auto this_thread() -> thread_stats & {
+    thread_local registered_thread_stats s;
+    return s.stats;
+}
+
+auto snapshot() -> thread_stats {
+    // bring the calling thread's time split up to date, the timer it's in keeps running
+    charge(this_thread(), now_ns());
+
+    auto &r = get_registry();
+    std::lock_guard lock{r.mutex};
+    thread_stats total;
+    total.merge(r.exited);
+    for (auto *s : r.threads) {
+        total.merge(*s);
+    }
+    return total;
+}
+
+void reset() {
+    auto &r = get_registry();
+    std::lock_guard lock{r.mutex};
+    r.exited = thread_stats{};
+    for (auto *s : r.threads) {
+        // keep the bookkeeping of timers and commands in flight
+        auto current = s->current;
+        auto active = s->active;
+        auto syscall_count = s->syscall_count;
+        auto stop_count = s->stop_count;
+        auto last_stop = s->last_stop_ns;
+        *s = thread_stats{};
+        s->current = current;
+        s->current_since = now_ns();
+        s->active = active;
+        s->syscall_count = syscall_count;
+        s->stop_count = stop_count;
+        s->last_stop_ns = last_stop;
+    }
+}
+
+void report(std::ostream &out) {
+    auto s = snapshot();
+    auto flags = out.flags();
+    auto fill = out.fill();
+    out << std::dec << std::setfill(' ');
+
+    out << "commands:\n";
+    for (const auto &[name, c] : s.commands) {
+        out << "  " << std::left << std::setw(20) << name << std::right << std::setw(8) << c.runs << " runs"
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << static_cast<double>(c.syscalls) / c.runs << " syscalls/run";
+        out << std::defaultfloat;
+        write_percentiles(out, c.latency);
+        out << "\n";
+    }
+
+    out << "syscalls:\n";
+    for (std::size_t i = 0; i < n_syscalls; ++i) {
+        if (!s.syscalls[i].count()) {
+            continue;
+        }
+        out << "  " << std::left << std::setw(20) << to_string(static_cast<syscall>(i)) << std::right
+            << std::setw(8) << s.syscalls[i].count() << " calls";
+        write_percentiles(out, s.syscalls[i]);
+        out << "\n";
+    }
+
+    out << "stop to prompt:\n  " << std::setw(28) << s.stop_to_prompt.count() << " stops";
+    write_percentiles(out, s.stop_to_prompt);
+    out << "\n";
+
+    std::uint64_t total = 0;
+    for (auto t : s.time_ns) {
+        total += t;
+    }
+    out << "time split:\n";
+    for (std::size_t i = 0; i < n_categories; ++i) {
+        out << "  " << std::left << std::setw(20) << to_string(static_cast<category>(i)) << std::right
+            << std::setw(8);
+        write_duration(out, s.time_ns[i]);
+        out << std::setw(8) << std::fixed << std::setprecision(1)
+            << (total ? 100.0 * s.time_ns[i] / total : 0.0) << "%\n" << std::defaultfloat;
+    }
+
+    out.flags(flags);
+    out.fill(fill);
+}
+
+void report_json(std::ostream &out) {
+    auto s = snapshot();
+    auto flags = out.flags();
+    auto fill = out.fill();
+    out << std::dec << std::setfill(' ');
+
+    out << "{\n  \"commands\": {";
+    const char *separator = "\n";
+    for (const auto &[name, c] : s.commands) {
+        out << separator << "    ";
+        write_json_string(out, name);
+        out << ": {\"runs\": " << c.runs << ", \"syscalls\": " << c.syscalls << ", \"latency\": ";
+        write_json_histogram(out, c.latency);
+        out << "}";
+        separator = ",\n";
+    }
+    out << "\n  },\n  \"syscalls\": {";
+    separator = "\n";
+    for (std::size_t i = 0; i < n_syscalls; ++i) {
+        out << separator << "    \"" << to_string(static_cast<syscall>(i)) << "\": ";
+        write_json_histogram(out, s.syscalls[i]);
+        separator = ",\n";
+    }
+    out << "\n  },\n  \"stop_to_prompt\": ";
+    write_json_histogram(out, s.stop_to_prompt);
+    out << ",\n  \"time_ns\": {";
+    separator = "";
+    for (std::size_t i = 0; i < n_categories; ++i) {
+        out << separator << "\"" << to_string(static_cast<category>(i)) << "\": " << s.time_ns[i];
+        separator = ", ";
+    }
+    out << "}\n}" << std::endl;
+
+    out.flags(flags);
+    out.fill(fill);
+}
+
+scoped_timer::scoped_timer(category c) {
+    auto &s = this_thread();
+    charge(s, now_ns());
+    ++s.active;
+    m_previous = s.current;
+    s.current = c;
+}
+
+scoped_timer::~scoped_timer() {
+    auto &s = this_thread();
+    charge(s, now_ns());
+    --s.active;
+    s.current = m_previous;
+}
+
+command_scope::command_scope(std::string name) : m_name{std::move(name)} {
+    auto &s = this_thread();
+    m_start = now_ns();
+    charge(s, m_start);
+    ++s.active;
+    m_syscalls_at_start = s.syscall_count;
+    m_stops_at_start = s.stop_count;
+}
+
+command_scope::~command_scope() {
+    auto &s = this_thread();
+    auto now = now_ns();
+    charge(s, now);
+    --s.active;
+
+    auto &c = s.commands[m_name];
+    ++c.runs;
+    c.syscalls += s.syscall_count - m_syscalls_at_start;
+    c.latency.record(now - m_start);
+
+    // the prompt comes back right after the command, so this is how long the user waited after the
+    // inferior stopped
+    if (s.stop_count != m_stops_at_start) {
+        s.stop_to_prompt.record(now - s.last_stop_ns);
+    }
+}
+
+void record_syscall(syscall s, std::uint64_t start_ns) {
+    auto &t = this_thread();
+    t.syscalls[static_cast<std::size_t>(s)].record(now_ns() - start_ns);
+    ++t.syscall_count;
+}
+
+auto to_syscall(__ptrace_request request) -> syscall {
+    switch (request) {
+        case PTRACE_PEEKDATA:
+            return syscall::peekdata;
+        case PTRACE_POKEDATA:
+            return syscall::pokedata;
+        case PTRACE_GETREGS:
+            return syscall::getregs;
+        case PTRACE_SETREGS:
+            return syscall::setregs;
+        case PTRACE_CONT:
+            return syscall::cont;
+        case PTRACE_SINGLESTEP:
+            return syscall::singlestep;
+        case PTRACE_GETSIGINFO:
+            return syscall::getsiginfo;
+        default:
+            return syscall::other_ptrace;
+    }
+}
+
+pid_t waitpid(pid_t pid, int *status, int options) {
+    scoped_timer timer{category::wait};
+    auto start = now_ns();
+    auto ret = ::waitpid(pid, status, options);
+    record_syscall(syscall::waitpid, start);
+
+    if (ret > 0) {
+        auto &s = this_thread();
+        s.last_stop_ns = now_ns();
+        ++s.stop_count;
+    }
+    return ret;
+}
+
+ssize_t process_vm_readv(pid_t pid, const iovec *local, unsigned long local_count,
+                         const iovec *remote, unsigned long remote_count, unsigned long flags) {
+    scoped_timer timer{category::ptrace};
+    auto start = now_ns();
+    auto ret = ::process_vm_readv(pid, local, local_count, remote, remote_count, flags);
+    record_syscall(syscall::process_vm_readv, start);
+    return ret;
+}
+
+ssize_t process_vm_writev(pid_t pid, const iovec *local, unsigned long local_count,
+                          const iovec *remote, unsigned long remote_count, unsigned long flags) {
+    scoped_timer timer{category::ptrace};
+    auto start = now_ns();
+    auto ret = ::process_vm_writev(pid, local, local_count, remote, remote_count, flags);
+    record_syscall(syscall::process_vm_writev, start);
+    return ret;
+}
+
+} // namespace stats
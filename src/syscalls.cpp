@@ -0,0 +1,400 @@
+#include "../include/syscalls.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+namespace {
+
+#define SYSCALL(name, args) {#name, SYS_##name, args}
+
+const syscall_info syscalls[] = {
+        SYSCALL(read, "dxu"),
+        SYSCALL(write, "dxu"),
+        SYSCALL(open, "som"),
+        SYSCALL(close, "d"),
+        SYSCALL(stat, "sx"),
+        SYSCALL(fstat, "dx"),
+        SYSCALL(lstat, "sx"),
+        SYSCALL(poll, "xud"),
+        SYSCALL(lseek, "ddd"),
+        SYSCALL(mmap, "xuxxdd"),
+        SYSCALL(mprotect, "xux"),
+        SYSCALL(munmap, "xu"),
+        SYSCALL(brk, "x"),
+        SYSCALL(rt_sigaction, "dxx"),
+        SYSCALL(rt_sigprocmask, "dxx"),
+        SYSCALL(ioctl, "dxx"),
+        SYSCALL(pread64, "dxud"),
+        SYSCALL(pwrite64, "dxud"),
+        SYSCALL(readv, "dxd"),
+        SYSCALL(writev, "dxd"),
+        SYSCALL(access, "sd"),
+        SYSCALL(pipe, "x"),
+        SYSCALL(select, "dxxxx"),
+        SYSCALL(sched_yield, ""),
+        SYSCALL(mremap, "xuuxx"),
+        SYSCALL(madvise, "xud"),
+        SYSCALL(dup, "d"),
+        SYSCALL(dup2, "dd"),
+        SYSCALL(nanosleep, "xx"),
+        SYSCALL(getpid, ""),
+        SYSCALL(sendfile, "ddxu"),
+        SYSCALL(socket, "ddd"),
+        SYSCALL(connect, "dau"),
+        SYSCALL(accept, "dxx"),
+        SYSCALL(sendto, "dxuxau"),
+        SYSCALL(recvfrom, "dxuxxx"),
+        SYSCALL(sendmsg, "dxx"),
+        SYSCALL(recvmsg, "dxx"),
+        SYSCALL(shutdown, "dd"),
+        SYSCALL(bind, "dau"),
+        SYSCALL(listen, "dd"),
+        SYSCALL(getsockname, "dxx"),
+        SYSCALL(getpeername, "dxx"),
+        SYSCALL(socketpair, "dddx"),
+        SYSCALL(setsockopt, "dddxu"),
+        SYSCALL(getsockopt, "dddxx"),
+        SYSCALL(clone, "xxxxx"),
+        SYSCALL(fork, ""),
+        SYSCALL(vfork, ""),
+        SYSCALL(execve, "sxx"),
+        SYSCALL(exit, "d"),
+        SYSCALL(wait4, "dxdx"),
+        SYSCALL(kill, "dd"),
+        SYSCALL(uname, "x"),
+        SYSCALL(fcntl, "ddx"),
+        SYSCALL(flock, "dd"),
+        SYSCALL(fsync, "d"),
+        SYSCALL(fdatasync, "d"),
+        SYSCALL(truncate, "sd"),
+        SYSCALL(ftruncate, "dd"),
+        SYSCALL(getcwd, "xu"),
+        SYSCALL(chdir, "s"),
+        SYSCALL(fchdir, "d"),
+        SYSCALL(rename, "ss"),
+        SYSCALL(mkdir, "sm"),
+        SYSCALL(rmdir, "s"),
+        SYSCALL(creat, "sm"),
+        SYSCALL(link, "ss"),
+        SYSCALL(unlink, "s"),
+        SYSCALL(symlink, "ss"),
+        SYSCALL(readlink, "sxu"),
+        SYSCALL(chmod, "sm"),
+        SYSCALL(fchmod, "dm"),
+        SYSCALL(chown, "sdd"),
+        SYSCALL(umask, "m"),
+        SYSCALL(gettimeofday, "xx"),
+        SYSCALL(getuid, ""),
+        SYSCALL(getgid, ""),
+        SYSCALL(setuid, "d"),
+        SYSCALL(setgid, "d"),
+        SYSCALL(geteuid, ""),
+        SYSCALL(getegid, ""),
+        SYSCALL(getppid, ""),
+        SYSCALL(setsid, ""),
+        SYSCALL(arch_prctl, "dx"),
+        SYSCALL(gettid, ""),
+        SYSCALL(futex, "xddxxd"),
+        SYSCALL(sched_getaffinity, "dux"),
+        SYSCALL(getdents64, "dxu"),
+        SYSCALL(set_tid_address, "x"),
+        SYSCALL(clock_gettime, "dx"),
+        SYSCALL(clock_nanosleep, "ddxx"),
+        SYSCALL(exit_group, "d"),
+        SYSCALL(epoll_wait, "dxdd"),
+        SYSCALL(epoll_ctl, "dddx"),
+        SYSCALL(tgkill, "ddd"),
+        SYSCALL(openat, "fsom"),
+        SYSCALL(mkdirat, "fsm"),
+        SYSCALL(newfstatat, "fsxd"),
+        SYSCALL(unlinkat, "fsd"),
+        SYSCALL(renameat, "fsfs"),
+        SYSCALL(readlinkat, "fsxu"),
+        SYSCALL(faccessat, "fsd"),
+        SYSCALL(pselect6, "dxxxxx"),
+        SYSCALL(ppoll, "xuxxu"),
+        SYSCALL(set_robust_list, "xu"),
+        SYSCALL(epoll_pwait, "dxddxu"),
+        SYSCALL(accept4, "dxxd"),
+        SYSCALL(eventfd2, "ud"),
+        SYSCALL(epoll_create1, "d"),
+        SYSCALL(dup3, "ddd"),
+        SYSCALL(pipe2, "xd"),
+        SYSCALL(prlimit64, "ddxx"),
+        SYSCALL(getrandom, "xuu"),
+        SYSCALL(memfd_create, "su"),
+        SYSCALL(execveat, "fsxxd"),
+        SYSCALL(statx, "fsdux"),
+        SYSCALL(rseq, "xudd"),
+        SYSCALL(clone3, "xu"),
+        SYSCALL(close_range, "ddu"),
+        SYSCALL(openat2, "fsxu"),
+        SYSCALL(faccessat2, "fsdd"),
+};
+
+#undef SYSCALL
+
+// arguments of a syscall in the order of the x86-64 syscall ABI
+void syscall_arguments(const user_regs_struct &regs, std::uint64_t (&args)[6]) {
+    args[0] = regs.rdi;
+    args[1] = regs.rsi;
+    args[2] = regs.rdx;
+    args[3] = regs.r10;
+    args[4] = regs.r8;
+    args[5] = regs.r9;
+}
+
+void format_string(std::ostream &out, std::uint64_t address, const memory_reader &read) {
+    constexpr std::size_t max_length = 64;
+    char buffer[max_length + 1];
+    auto n = address ? read(address, buffer, sizeof buffer) : 0;
+    if (n == 0) {
+        out << "0x" << std::hex << address << std::dec;
+        return;
+    }
+
+    auto end = std::find(buffer, buffer + n, '\0');
+    auto length = std::min<std::size_t>(end - buffer, max_length);
+    out << '"';
+    for (std::size_t i = 0; i < length; ++i) {
+        auto c = static_cast<unsigned char>(buffer[i]);
+        switch (c) {
+            case '"':
+            case '\\':
+                out << '\\' << c;
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (c < 0x20 || c >= 0x7f) {
+                    static const char digits[] = "0123456789abcdef";
+                    out << "\\x" << digits[c >> 4] << digits[c & 0xf];
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+    if (end == buffer + n) {
+        out << "...";
+    }
+}
+
+void format_open_flags(std::ostream &out, std::uint64_t flags) {
+    switch (flags & O_ACCMODE) {
+        case O_WRONLY:
+            out << "O_WRONLY";
+            break;
+        case O_RDWR:
+            out << "O_RDWR";
+            break;
+        default:
+            out << "O_RDONLY";
+    }
+    flags &= ~std::uint64_t{O_ACCMODE};
+
+    static const std::pair<std::uint64_t, const char *> names[] = {
+            {O_TMPFILE, "O_TMPFILE"}, // includes O_DIRECTORY, goes first
+            {O_CREAT, "O_CREAT"},
+            {O_EXCL, "O_EXCL"},
+            {O_NOCTTY, "O_NOCTTY"},
+            {O_TRUNC, "O_TRUNC"},
+            {O_APPEND, "O_APPEND"},
+            {O_NONBLOCK, "O_NONBLOCK"},
+            {O_DSYNC, "O_DSYNC"},
+            {O_DIRECT, "O_DIRECT"},
+            {O_DIRECTORY, "O_DIRECTORY"},
+            {O_NOFOLLOW, "O_NOFOLLOW"},
+            {O_NOATIME, "O_NOATIME"},
+            {O_CLOEXEC, "O_CLOEXEC"},
+            {O_PATH, "O_PATH"},
+    };
+    for (const auto &[flag, name] : names) {
+        if ((flags & flag) == flag) {
+            out << '|' << name;
+            flags &= ~flag;
+        }
+    }
+    if (flags) {
+        out << "|0x" << std::hex << flags << std::dec;
+    }
+}
+
+void format_socket_address(std::ostream &out, std::uint64_t address, std::uint64_t length,
+                           const memory_reader &read) {
+    sockaddr_storage storage{};
+    auto n = address ? read(address, &storage, std::min<std::uint64_t>(length, sizeof storage)) : 0;
+    if (n < sizeof storage.ss_family) {
+        out << "0x" << std::hex << address << std::dec;
+        return;
+    }
+
+    char text[INET6_ADDRSTRLEN];
+    switch (storage.ss_family) {
+        case AF_INET: {
+            auto in = reinterpret_cast<const sockaddr_in *>(&storage);
+            inet_ntop(AF_INET, &in->sin_addr, text, sizeof text);
+            out << "{AF_INET, " << text << ':' << ntohs(in->sin_port) << '}';
+            break;
+        }
+        case AF_INET6: {
+            auto in6 = reinterpret_cast<const sockaddr_in6 *>(&storage);
+            inet_ntop(AF_INET6, &in6->sin6_addr, text, sizeof text);
+            out << "{AF_INET6, [" << text << "]:" << ntohs(in6->sin6_port) << '}';
+            break;
+        }
+        case AF_UNIX: {
+            auto un = reinterpret_cast<const sockaddr_un *>(&storage);
+            auto path_length = n - offsetof(sockaddr_un, sun_path);
+            // abstract sockets start with a NUL byte and aren't NUL terminated
+            if (path_length > 0 && un->sun_path[0] == '\0') {
+                out << "{AF_UNIX, @" << std::string_view{un->sun_path + 1, path_length - 1} << '}';
+            } else {
+                out << "{AF_UNIX, " << std::string_view{un->sun_path, strnlen(un->sun_path, path_length)} << '}';
+            }
+            break;
+        }
+        default:
+            out << "{family " << storage.ss_family << '}';
+    }
+}
+
+} // namespace
+
+const syscall_info *find_syscall(std::string_view name) {
+    for (const auto &info : syscalls) {
+        if (name == info.name) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+const syscall_info *find_syscall(long number) {
+    for (const auto &info : syscalls) {
+        if (info.number == number) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+std::string format_syscall(const user_regs_struct &regs, const memory_reader &read) {
+    // at a syscall entry stop rax already holds -ENOSYS, the number is in orig_rax
+    auto number = static_cast<long>(regs.orig_rax);
+    std::uint64_t args[6];
+    syscall_arguments(regs, args);
+
+    std::ostringstream out;
+    auto info = find_syscall(number);
+    if (!info) {
+        // unknown signature, show all six registers
+        out << "syscall_" << number << '(';
+        for (int i = 0; i < 6; ++i) {
+            out << (i ? ", " : "") << "0x" << std::hex << args[i] << std::dec;
+        }
+        out << ')';
+        return out.str();
+    }
+
+    out << info->name << '(';
+    for (std::size_t i = 0; info->args[i]; ++i) {
+        auto value = args[i];
+        // the mode after the open flags is garbage unless a file gets created
+        if (info->args[i] == 'm' && i && info->args[i - 1] == 'o' &&
+            !(args[i - 1] & O_CREAT) && (args[i - 1] & O_TMPFILE) != O_TMPFILE) {
+            break;
+        }
+        if (i) {
+            out << ", ";
+        }
+        switch (info->args[i]) {
+            case 'd':
+                out << static_cast<int>(value);
+                break;
+            case 'u':
+                out << value;
+                break;
+            case 's':
+                format_string(out, value, read);
+                break;
+            case 'f':
+                if (static_cast<int>(value) == AT_FDCWD) {
+                    out << "AT_FDCWD";
+                } else {
+                    out << static_cast<int>(value);
+                }
+                break;
+            case 'o':
+                format_open_flags(out, value);
+                break;
+            case 'm':
+                out << '0' << std::oct << value << std::dec;
+                break;
+            case 'a':
+                format_socket_address(out, value, args[i + 1], read);
+                break;
+            default:
+                out << "0x" << std::hex << value << std::dec;
+        }
+    }
+    out << ')';
+    return out.str();
+}
+
+std::string format_syscall_result(const user_regs_struct &regs) {
+    auto result = static_cast<long>(regs.rax);
+    // the kernel returns errors as -errno, between -4095 and -1
+    if (result < 0 && result >= -4095) {
+        return "-1 (" + std::string{strerror(static_cast<int>(-result))} + ")";
+    }
+
+    // addresses, e.g. from mmap or brk, read better in hex
+    if (result > 0xffff) {
+        std::ostringstream out;
+        out << "0x" << std::hex << result;
+        return out.str();
+    }
+    return std::to_string(result);
+}
+
+bool install_syscall_filter(const std::vector<long> &numbers) {
+    if (numbers.empty() || numbers.size() > max_filtered_syscalls) {
+        errno = EINVAL;
+        return false;
+    }
+
+    auto n = static_cast<unsigned char>(numbers.size());
+    std::vector<sock_filter> filter{
+            // let 32-bit syscalls through, their numbers differ. x32 ones have bit 30 set and match none below
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, static_cast<unsigned char>(n + 1)),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)),
+    };
+    for (unsigned char i = 0; i < n; ++i) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<std::uint32_t>(numbers[i]),
+                                  static_cast<unsigned char>(n - i), 0));
+    }
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+
+    sock_fprog program{static_cast<unsigned short>(filter.size()), filter.data()};
+    // unprivileged processes may only install filters once they can't gain privileges, e.g. through setuid
+    return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 &&
+           prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
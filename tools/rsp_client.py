@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+"""Drives `debugger --server` through a scripted GDB remote protocol session.
+
+    tools/rsp_client.py path/to/debugger [--cxx c++]
+
+Builds a small inferior, serves it on a unix socket and checks the replies to
+qSupported, QStartNoAckMode, ?, g, G, p, P, m, x, X, Z0/z0, qXfer:threads,
+qXfer:libraries, vCont;s, vCont;c and 0x03 interrupts, both while the inferior
+runs and while it is stopped. Exits non-zero on the first unexpected reply.
+"""
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+INFERIOR = r"""
+volatile unsigned counter;
+
+int step(int x) {
+    return x + 1;
+}
+
+int main() {
+    counter = step(41);
+    for (;;) {
+        counter = counter + 1;
+    }
+}
+"""
+
+# offsets into the 'g' reply, which has the registers in GDB's amd64 order
+RSP_OFFSET = 7 * 16
+RIP_OFFSET = 16 * 16
+
+
+def read_symbols(path):
+    """Returns the file's bytes and {name: (address, file offset)} of its .symtab, for x86-64 ELF."""
+    with open(path, "rb") as f:
+        data = f.read()
+    shoff, = struct.unpack_from("<Q", data, 0x28)
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x3a)
+    sections = [struct.unpack_from("<IIQQQQIIQQ", data, shoff + i * shentsize) for i in range(shnum)]
+
+    symbols = {}
+    for _, type_, _, _, offset, size, link, _, _, entsize in sections:
+        if type_ != 2:  # SHT_SYMTAB
+            continue
+        strtab = sections[link][4]
+        for pos in range(offset, offset + size, entsize):
+            name, _, _, shndx, value, _ = struct.unpack_from("<IBBHQQ", data, pos)
+            if not name or shndx == 0 or shndx >= shnum:
+                continue
+            end = data.index(b"\0", strtab + name)
+            section = sections[shndx]
+            file_offset = value - section[3] + section[4] if section[1] != 8 else None  # not SHT_NOBITS
+            symbols[data[strtab + name:end].decode()] = (value, file_offset)
+    return data, symbols
+
+
+class Client:
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX)
+        self.sock.settimeout(10)
+        self.sock.connect(path)
+        self.buffer = b""
+        self.acks = True
+
+    def send(self, payload):
+        if isinstance(payload, str):
+            payload = payload.encode()
+        checksum = sum(payload) & 0xff
+        self.sock.sendall(b"$" + payload + b"#" + b"%02x" % checksum)
+
+    def receive(self):
+        while True:
+            start = self.buffer.find(b"$")
+            end = self.buffer.find(b"#", start)
+            if start >= 0 and end >= 0 and len(self.buffer) >= end + 3:
+                if self.acks and not self.buffer[:start].endswith(b"+"):
+                    fail("packet was not acknowledged")
+                payload = self.buffer[start + 1:end]
+                if int(self.buffer[end + 1:end + 3], 16) != sum(payload) & 0xff:
+                    fail("bad checksum on reply " + repr(payload[:40]))
+                self.buffer = self.buffer[end + 3:]
+                if self.acks:
+                    self.sock.sendall(b"+")
+                return payload
+            chunk = self.sock.recv(1 << 20)
+            if not chunk:
+                fail("server closed the connection")
+            self.buffer += chunk
+
+    def query(self, payload):
+        self.send(payload)
+        return self.receive()
+
+
+def unescape(data):
+    """Undoes the } escapes of binary replies."""
+    out = bytearray()
+    escaped = False
+    for b in data:
+        if escaped:
+            out.append(b ^ 0x20)
+            escaped = False
+        elif b == ord("}"):
+            escaped = True
+        else:
+            out.append(b)
+    return bytes(out)
+
+
+def register(reply):
+    """The value of a register from a p reply."""
+    return int.from_bytes(bytes.fromhex(reply.decode()), "little")
+
+
+def fail(message):
+    print("FAIL:", message)
+    sys.exit(1)
+
+
+def expect(name, reply, ok):
+    if not ok:
+        fail("%s: unexpected reply %r" % (name, reply[:80]))
+    print("ok  ", name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("debugger")
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "c++"))
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as work:
+        source = os.path.join(work, "inferior.cpp")
+        program = os.path.join(work, "inferior")
+        with open(source, "w") as f:
+            f.write(INFERIOR)
+        # libdwarf++ reads DWARF 2 to 4
+        subprocess.check_call([args.cxx, "-O0", "-gdwarf-4", "-no-pie", source, "-o", program])
+        image, symbols = read_symbols(program)
+        step_addr, step_offset = symbols["_Z4stepi"]
+        counter_addr = symbols["counter"][0]
+        # enough of the code to have bytes that need escaping in binary replies
+        step_code = image[step_offset:step_offset + 64]
+
+        socket_path = os.path.join(work, "rsp.sock")
+        server = subprocess.Popen([args.debugger, "--server", socket_path, program], stdout=subprocess.DEVNULL)
+        try:
+            for _ in range(100):
+                if os.path.exists(socket_path):
+                    break
+                if server.poll() is not None:
+                    fail("debugger exited with status %d before listening" % server.returncode)
+                time.sleep(0.05)
+            client = Client(socket_path)
+            run(client, step_addr, step_code, counter_addr)
+        finally:
+            if server.poll() is None:
+                server.kill()
+            server.wait()
+    print("all packets ok")
+
+
+def run(client, step_addr, step_code, counter_addr):
+    reply = client.query("qSupported:multiprocess+;swbreak+")
+    expect("qSupported", reply, b"PacketSize=" in reply and b"QStartNoAckMode+" in reply)
+
+    reply = client.query("QStartNoAckMode")
+    expect("QStartNoAckMode", reply, reply == b"OK")
+    client.acks = False
+
+    reply = client.query("?")
+    expect("?", reply, reply[:1] in (b"S", b"T"))
+
+    reply = client.query("g")
+    expect("g", reply, len(reply) >= RIP_OFFSET + 16 and all(c in b"0123456789abcdefx" for c in reply))
+
+    reply = client.query("Z0,%x,1" % step_addr)
+    expect("Z0", reply, reply == b"OK")
+
+    reply = client.query("vCont;c")
+    expect("vCont;c to the breakpoint", reply, reply.startswith(b"T05"))
+    thread = reply[reply.index(b"thread:") + 7:].split(b";")[0]
+
+    reply = client.query("g")
+    rip, = struct.unpack("<Q", bytes.fromhex(reply[RIP_OFFSET:RIP_OFFSET + 16].decode()))
+    expect("g after the breakpoint", reply, rip == step_addr)
+
+    # an interrupt while stopped still gets a stop reply
+    client.sock.sendall(b"\x03")
+    reply = client.receive()
+    expect("0x03 while stopped", reply, reply[:1] == b"T")
+
+    # the breakpoint's int3 is hidden from memory reads
+    reply = client.query("m%x,4" % step_addr)
+    expect("m", reply, reply == step_code[:4].hex().encode())
+
+    reply = client.query("x%x,%x" % (step_addr, len(step_code)))
+    expect("x", reply, reply[:1] == b"b" and unescape(reply[1:]) == step_code)
+
+    reply = client.query("p10")
+    expect("p of rip", reply, register(reply) == step_addr)
+
+    registers = client.query("g")
+    rax = client.query("p0")
+    reply = client.query("P0=%s" % struct.pack("<Q", 0x1122334455667788).hex())
+    expect("P", reply, reply == b"OK")
+    reply = client.query("p0")
+    expect("p after P", reply, register(reply) == 0x1122334455667788)
+    client.query("P0=" + rax.decode())
+
+    # rbx is the second register
+    rbx = struct.pack("<Q", 0x8877665544332211).hex().encode()
+    reply = client.query(b"G" + registers[:16] + rbx + registers[32:])
+    expect("G", reply, reply == b"OK")
+    reply = client.query("p1")
+    expect("p after G", reply, register(reply) == 0x8877665544332211)
+    reply = client.query(b"G" + registers)
+    expect("G to restore", reply, reply == b"OK")
+
+    reply = client.query("qXfer:threads:read::0,fff")
+    expect("qXfer:threads", reply, reply[:1] in (b"l", b"m") and b'<thread id="' + thread + b'"' in unescape(reply[1:]))
+
+    reply = client.query("qXfer:libraries:read::0,fff")
+    expect("qXfer:libraries", reply, reply[:1] in (b"l", b"m") and b"libc" in unescape(reply[1:]))
+
+    # steps off the breakpoint, it stays in place
+    reply = client.query("vCont;s")
+    expect("vCont;s", reply, reply.startswith(b"T05"))
+    reply = client.query("p10")
+    expect("p after vCont;s", reply, step_addr < register(reply) < step_addr + len(step_code))
+
+    reply = client.query("g")
+    rsp, = struct.unpack("<Q", bytes.fromhex(reply[RSP_OFFSET:RSP_OFFSET + 16].decode()))
+    # binary data has '#', '$', '}' and '*' escaped as } followed by the byte xor 0x20
+    written = b"#$}*"
+    escaped = b"".join(b"}" + bytes([b ^ 0x20]) for b in written)
+    reply = client.query(b"X%x,4:" % (rsp - 64) + escaped)
+    expect("X", reply, reply == b"OK")
+    reply = client.query("m%x,4" % (rsp - 64))
+    expect("m after X", reply, reply == written.hex().encode())
+    reply = client.query("x%x,4" % (rsp - 64))
+    expect("x of escaped bytes", reply, reply == b"b" + escaped)
+
+    reply = client.query("z0,%x,1" % step_addr)
+    expect("z0", reply, reply == b"OK")
+
+    # the program spins from here on, only an interrupt stops it
+    client.send("vCont;c")
+    time.sleep(0.2)
+    client.sock.sendall(b"\x03")
+    reply = client.receive()
+    expect("0x03 interrupt", reply, reply.startswith(b"T02"))
+
+    reply = client.query("m%x,4" % counter_addr)
+    counter, = struct.unpack("<I", bytes.fromhex(reply.decode()))
+    expect("m of the counter", reply, counter > 42)
+
+    client.send("k")
+
+
+if __name__ == "__main__":
+    main()